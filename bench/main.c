@@ -0,0 +1,287 @@
+// vtk2 layout and frame-time benchmarks
+//
+// Usage: bench [tree [size [frames [threads]]]]
+// tree is one of deep, wide, text, list or all (the default)
+// threads enables parallel layout with that many threads (default 1)
+//
+// Each tree is rendered into a headless window. For every phase, per-frame
+// times and allocation counts are reported as one JSON object per line:
+// - layout: full layout of the tree, with every block invalidated
+// - relayout: layout of the tree when nothing has changed
+// - draw: draw submission of the whole tree, without flushing to GL
+// - mouse: dispatch of 100 pointer motion events sweeping across the window
+// - frame: a complete forced redraw through vtk2_window_draw, including GL
+//
+// Build with make; results can be compared between versions to catch regressions
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <epoxy/gl.h>
+#include "../vtk2.h"
+
+//// Allocation counting ////
+static size_t allocs;
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size) {
+	allocs++;
+	return __real_malloc(size);
+}
+void *__wrap_calloc(size_t n, size_t size) {
+	allocs++;
+	return __real_calloc(n, size);
+}
+void *__wrap_realloc(void *ptr, size_t size) {
+	allocs++;
+	return __real_realloc(ptr, size);
+}
+
+//// Tree generation ////
+struct tree {
+	struct vtk2_arena arena;
+	struct vtk2_block *root;
+	struct vtk2_block **blocks; // Every block in the tree, for invalidation
+	size_t nblocks, cap;
+	unsigned tick; // Changes every frame, to drive dynamic text
+	struct vtk2_block *last; // Most recently created block
+};
+
+static struct vtk2_block *track(struct tree *tree, enum vtk2_err err) {
+	if (err) {
+		vtk2_perror("error creating block", err);
+		abort();
+	}
+	if (tree->nblocks == tree->cap) {
+		tree->cap = tree->cap ? 2 * tree->cap : 256;
+		tree->blocks = realloc(tree->blocks, tree->cap * sizeof *tree->blocks);
+		if (!tree->blocks) abort();
+	}
+	tree->blocks[tree->nblocks++] = tree->last;
+	return tree->last;
+}
+
+// Only use once per statement, since the result goes through tree->last
+#define NEW(tree, type, ...) track(tree, vtk2_new_##type(&(tree)->arena, &(tree)->last, __VA_ARGS__))
+
+// Boxes nested size levels deep, alternating direction, each with a label and a growing sibling
+static struct vtk2_block *make_deep(struct tree *tree, int size) {
+	struct vtk2_block *inner = NEW(tree, box, .size = {8, 8});
+	for (int i = 0; i < size; i++) {
+		struct vtk2_block *children[4] = {NULL, inner, NULL, NULL};
+		children[0] = NEW(tree, static_text, .text = "level");
+		children[2] = NEW(tree, box, .grow = 1, .margins = {1, 1, 1, 1});
+		inner = NEW(tree, box, .direction = i % 2 ? VTK2_ROW : VTK2_COL, .margins = {2, 2, 2, 2}, .children = children);
+	}
+	return inner;
+}
+
+// A single row of size boxes
+static struct vtk2_block *make_wide(struct tree *tree, int size) {
+	struct vtk2_block **children = calloc(size + 1, sizeof *children);
+	if (!children) abort();
+	for (int i = 0; i < size; i++) {
+		children[i] = NEW(tree, box, .grow = i % 3, .size = {1, NAN}, .margins = {1, 1, 1, 1});
+	}
+	struct vtk2_block *root = NEW(tree, box, .children = children);
+	free(children);
+	return root;
+}
+
+// A size x size grid of text cells, half of which change every frame
+static const char *cell_text(size_t *len, void *data) {
+	static char buf[32];
+	struct tree *tree = data;
+	int n = snprintf(buf, sizeof buf, "%u", tree->tick);
+	*len = n < 0 ? 0 : n;
+	return buf;
+}
+static struct vtk2_block *make_text(struct tree *tree, int size) {
+	struct vtk2_block **rows = calloc(size + 1, sizeof *rows);
+	struct vtk2_block **cells = calloc(size + 1, sizeof *cells);
+	if (!rows || !cells) abort();
+
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			if ((x + y) % 2) {
+				cells[x] = NEW(tree, text, .text_fn = cell_text, .data = tree, .grow = 1, .font_size = 12);
+			} else {
+				cells[x] = NEW(tree, static_text, .text = "static", .grow = 1, .font_size = 12);
+			}
+		}
+		rows[y] = NEW(tree, box, .grow = 1, .children = cells);
+	}
+	struct vtk2_block *root = NEW(tree, box, .direction = VTK2_COL, .children = rows);
+	free(rows);
+	free(cells);
+	return root;
+}
+
+// A list of size text rows, of which only a screenful exist
+static struct vtk2_block *list_row_new(void *data) {
+	return NEW((struct tree *)data, text, .font_size = 12);
+}
+static void list_row_bind(struct vtk2_block *row, size_t index, void *data) {
+	char buf[32];
+	int n = snprintf(buf, sizeof buf, "row %zu", index);
+	vtk2_text_set(row, buf, n < 0 ? 0 : n);
+}
+static struct vtk2_block *make_list(struct tree *tree, int size) {
+	return NEW(tree, list, .count = size, .row_height = 16, .row_new = list_row_new, .row_bind = list_row_bind, .data = tree);
+}
+
+//// Measurement ////
+static int threads = 1;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double p) {
+	int i = (int)(p * (n - 1) + 0.5);
+	return sorted[i];
+}
+
+static void report(const char *tree, int size, size_t nblocks, const char *phase, double *times, int frames, size_t nallocs) {
+	qsort(times, frames, sizeof *times, cmp_double);
+	printf("{\"tree\":\"%s\",\"size\":%d,\"blocks\":%zu,\"threads\":%d,\"phase\":\"%s\",\"frames\":%d,"
+		"\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,\"allocs_per_frame\":%.3f}\n",
+		tree, size, nblocks, threads, phase, frames,
+		1e6 * percentile(times, frames, 0.5), 1e6 * percentile(times, frames, 0.9),
+		1e6 * percentile(times, frames, 0.99), 1e6 * times[frames - 1],
+		(double)nallocs / frames);
+	fflush(stdout);
+}
+
+static int run(const char *name, struct vtk2_block *(*make)(struct tree *, int), int size, int frames) {
+	struct vtk2_win win;
+	enum vtk2_err err = vtk2_window_init_headless(&win, 1280, 720);
+	if (err) {
+		vtk2_perror("error creating headless window", err);
+		return 1;
+	}
+	if ((err = vtk2_window_parallel_layout(&win, threads))) {
+		vtk2_perror("error starting layout threads", err);
+		return 1;
+	}
+
+	struct tree tree = {0};
+	vtk2_arena_init(&tree.arena);
+	tree.root = make(&tree, size);
+	if ((err = vtk2_window_set_root(&win, tree.root))) {
+		vtk2_perror("error setting root element", err);
+		return 1;
+	}
+
+	double *times = malloc(frames * sizeof *times);
+	if (!times) abort();
+	float rect[4] = {0, 0, win.win_w, win.win_h};
+	size_t nallocs;
+
+	// Warm up caches before measuring anything
+	vtk2_window_draw(&win);
+
+	nallocs = allocs;
+	for (int i = 0; i < frames; i++) {
+		for (size_t j = 0; j < tree.nblocks; j++) {
+			vtk2_block_invalidate(tree.blocks[j]);
+		}
+		double t = now();
+		vtk2_block_layout(tree.root, rect, VTK2_SHRINK_NONE);
+		times[i] = now() - t;
+	}
+	report(name, size, tree.nblocks, "layout", times, frames, allocs - nallocs);
+
+	nallocs = allocs;
+	for (int i = 0; i < frames; i++) {
+		double t = now();
+		vtk2_block_layout(tree.root, rect, VTK2_SHRINK_NONE);
+		times[i] = now() - t;
+	}
+	report(name, size, tree.nblocks, "relayout", times, frames, allocs - nallocs);
+
+	nallocs = allocs;
+	for (int i = 0; i < frames; i++) {
+		double t = now();
+		nvgBeginFrame(win.vg, win.win_w, win.win_h, 1);
+		memcpy(win.clip, rect, sizeof win.clip);
+		tree.root->type->draw(tree.root);
+		nvgCancelFrame(win.vg);
+		times[i] = now() - t;
+	}
+	report(name, size, tree.nblocks, "draw", times, frames, allocs - nallocs);
+
+	nallocs = allocs;
+	for (int i = 0; i < frames; i++) {
+		double t = now();
+		float ox = -1, oy = -1;
+		for (int j = 0; j < 100; j++) {
+			float x = (j + 0.5f) * rect[2] / 100, y = (j + 0.5f) * rect[3] / 100;
+			if (tree.root->type->ev_mouse) tree.root->type->ev_mouse(tree.root, x, y, ox, oy);
+			ox = x, oy = y;
+		}
+		times[i] = now() - t;
+	}
+	report(name, size, tree.nblocks, "mouse", times, frames, allocs - nallocs);
+
+	nallocs = allocs;
+	for (int i = 0; i < frames; i++) {
+		tree.tick++;
+		double t = now();
+		vtk2_window_redraw(&win);
+		vtk2_window_draw(&win);
+		glFinish();
+		times[i] = now() - t;
+	}
+	report(name, size, tree.nblocks, "frame", times, frames, allocs - nallocs);
+
+	free(times);
+	vtk2_window_deinit(&win);
+	vtk2_arena_deinit(&tree.arena);
+	free(tree.blocks);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	static const struct {
+		const char *name;
+		struct vtk2_block *(*make)(struct tree *, int);
+		int size;
+	} trees[] = {
+		{"deep", make_deep, 12},
+		{"wide", make_wide, 5000},
+		{"text", make_text, 50},
+		{"list", make_list, 1000000},
+	};
+
+	const char *which = argc > 1 ? argv[1] : "all";
+	int size = argc > 2 ? atoi(argv[2]) : 0;
+	int frames = argc > 3 ? atoi(argv[3]) : 200;
+	if (frames < 1) frames = 1;
+	threads = argc > 4 ? atoi(argv[4]) : 1;
+	if (threads < 1) threads = 1;
+
+	int found = 0;
+	for (size_t i = 0; i < sizeof trees / sizeof *trees; i++) {
+		if (strcmp(which, "all") && strcmp(which, trees[i].name)) continue;
+		found = 1;
+		if (run(trees[i].name, trees[i].make, size > 0 ? size : trees[i].size, frames)) return 1;
+	}
+	if (!found) {
+		fprintf(stderr, "unknown tree: %s\n", which);
+		return 1;
+	}
+
+	glfwTerminate();
+	return 0;
+}
@@ -1,32 +1,25 @@
-#include <stdatomic.h>
 #include <stdio.h>
 #include <threads.h>
 #include "../vtk2.h"
 
 struct worker_data {
-	atomic_int x;
-	struct vtk2_win *win;
+	struct vtk2_block *timestamp;
 };
 
 int worker(void *data_p) {
 	struct worker_data *data = data_p;
-	for (;;) {
+	for (int x = 0;; x++) {
+		// Updates are applied on the main thread, so no locking is needed
+		char buf[1024];
+		int n = snprintf(buf, sizeof buf, "This example program has been running for %d seconds", x);
+		if (n < 0) vtk2_post_text(data->timestamp, "!! error occurred in string generation !!", SIZE_MAX);
+		else vtk2_post_text(data->timestamp, buf, n);
+
 		struct timespec ts = {.tv_sec = 1};
 		while (thrd_sleep(&ts, &ts) == -1);
-		data->x++;
-		vtk2_window_redraw(data->win);
 	}
 }
 
-const char *timestamp(size_t *len, void *data_p) {
-	struct worker_data *data = data_p;
-	static char buf[1024];
-	int n = snprintf(buf, sizeof buf, "This example program has been running for %d seconds", data->x);
-	if (n < 0) return "!! error occurred in string generation !!";
-	*len = n;
-	return buf;
-}
-
 int main() {
 	struct worker_data data = {0};
 
@@ -41,7 +34,7 @@ int main() {
 	struct vtk2_block *level1[] = {
 		vtk2_make_box(.margins = {10, 10, 10, 10}, .grow = 1, .direction = VTK2_COL, .children = level2),
 		vtk2_make_box(.margins = {10, 10, 10, 10}, .size = {400, 400}),
-		vtk2_make_text(.text_fn = timestamp, .data = &data, .font_color = {0, 1, 0, 1}, .margins = {10, 10, 10, 10}),
+		vtk2_make_text(.font_color = {0, 1, 0, 1}, .margins = {10, 10, 10, 10}),
 		NULL
 	};
 	struct vtk2_block *root = vtk2_make_box(.children = level1);
@@ -57,7 +50,7 @@ int main() {
 		return 1;
 	}
 
-	data.win = &win;
+	data.timestamp = level1[2];
 	thrd_t thr;
 	int thr_err = thrd_create(&thr, worker, &data);
 	if (thr_err != thrd_success) {
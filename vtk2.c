@@ -29,12 +29,36 @@
 // vtk2 embeds a modified version of Aileron Regular, created by Sora Sagano
 // http://dotcolon.net/font/aileron/
 
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+#	define _POSIX_C_SOURCE 200809L // For mmap and friends
+#endif
+
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <time.h>
+#	include <unistd.h>
+#	define VTK2_MMAP
+#endif
+
+#if defined(__SSE__) || defined(_M_X64)
+#	include <xmmintrin.h>
+#	define VTK2_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#	define VTK2_NEON
+#endif
+
 #include <epoxy/gl.h>
 #include <GLFW/glfw3.h>
+#ifdef VTK2_HEADLESS
+#	include <epoxy/egl.h>
+#endif
 
 #if defined(NANOVG_GL2_IMPLEMENTATION)
 #	define NVG_IMPL GL2
@@ -54,6 +78,7 @@
 
 #include "vtk2.h"
 #include "deps/nanovg/src/nanovg_gl.h"
+#include "deps/nanovg/src/nanovg_gl_utils.h"
 #include "deps/nanovg/src/nanovg.c"
 
 #define UNPACK_4(a) (a)[0], UNPACK_3((a)+1)
@@ -61,41 +86,140 @@
 #define UNPACK_2(a) (a)[0], (a)[1]
 
 //// Event handlers ////
+// Input is queued as it arrives and delivered at the start of the next frame, so a burst of cursor
+// movement between frames only walks the tree once. Window events take effect immediately
+static void _vtk2_app_queue(struct vtk2_win *win);
+static void _vtk2_window_mouse(struct vtk2_win *win, float x, float y);
+static struct vtk2_block *_vtk2_hover_walk(struct vtk2_block *block, float x, float y, float bounds[4]);
+static const struct vtk2_block_type _vtk2_box_type, _vtk2_static_text_type, _vtk2_text_type, _vtk2_list_type;
+
+static void _vtk2_input_dispatch(struct vtk2_win *win, const struct vtk2_input *ev) {
+	struct vtk2_block *root = win->root;
+	switch (ev->kind) {
+	case VTK2_INPUT_BUTTON:
+		if (root && root->type->ev_button) {
+			root->type->ev_button(root, ev->button.button, ev->button.action, ev->button.mods);
+		}
+		break;
+	case VTK2_INPUT_ENTER:
+		if (root && root->type->ev_enter) {
+			root->type->ev_enter(root, ev->entered);
+		}
+		break;
+	case VTK2_INPUT_KEY:
+		if (root && root->type->ev_key) {
+			root->type->ev_key(root, ev->key.key, ev->key.scancode, ev->key.action, ev->key.mods);
+		}
+		break;
+	case VTK2_INPUT_MOUSE:
+		_vtk2_window_mouse(win, ev->pos[0], ev->pos[1]);
+		win->cx = ev->pos[0];
+		win->cy = ev->pos[1];
+		break;
+	case VTK2_INPUT_SCROLL:
+		if (root && root->type->ev_scroll) {
+			root->type->ev_scroll(root, ev->delta[0], ev->delta[1]);
+		}
+		break;
+	case VTK2_INPUT_TEXT:
+		if (root && root->type->ev_text) {
+			root->type->ev_text(root, ev->rune);
+		}
+		break;
+	}
+}
+
+// Deliver every queued event, in the order they arrived
+static void _vtk2_window_dispatch_input(struct vtk2_win *win) {
+	for (size_t i = 0; i < win->ninput; i++) {
+		_vtk2_input_dispatch(win, &win->input[i]);
+	}
+	win->ninput = 0;
+}
+
+static void _vtk2_input_push(struct vtk2_win *win, struct vtk2_input ev) {
+	if (win->ninput == win->input_cap) {
+		size_t cap = win->input_cap ? 2 * win->input_cap : 16;
+		struct vtk2_input *input = realloc(win->input, cap * sizeof *input);
+		if (!input) {
+			// Can't queue it, so deliver everything now instead
+			_vtk2_window_dispatch_input(win);
+			_vtk2_input_dispatch(win, &ev);
+			return;
+		}
+		win->input = input;
+		win->input_cap = cap;
+	}
+	win->input[win->ninput++] = ev;
+
+	atomic_flag_clear_explicit(&win->clean, memory_order_release);
+	_vtk2_app_queue(win);
+}
+
+// Get the last queued event if it is of the specified kind, so another can be merged into it
+static struct vtk2_input *_vtk2_input_last(struct vtk2_win *win, enum vtk2_input_kind kind) {
+	if (!win->ninput) return NULL;
+	struct vtk2_input *ev = &win->input[win->ninput - 1];
+	return ev->kind == kind ? ev : NULL;
+}
+
+// Check whether any block under the cursor at (x, y) wants every movement
+static _Bool _vtk2_window_raw_motion(struct vtk2_win *win, float x, float y) {
+	struct vtk2_block *end = win->hover;
+	if (!end && win->root) {
+		// The hover path is forgotten whenever a block moves, so find it again
+		float bounds[4] = {-INFINITY, -INFINITY, INFINITY, INFINITY};
+		end = _vtk2_hover_walk(win->root, x, y, bounds);
+		// A box that can't route the point has unknown children under it, which might want every movement
+		if (end->type == &_vtk2_box_type) return 1;
+	}
+	for (struct vtk2_block *block = end; block; block = block->parent) {
+		if (block->type->raw_motion) return 1;
+	}
+	return 0;
+}
+
 static void _vtk2_ev_button(GLFWwindow *glfw_win, int button, int action, int mods) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
-	if (win->root && win->root->ev_button) {
-		win->root->ev_button(win->root, button, action, mods);
-	}
+	_vtk2_input_push(win, (struct vtk2_input){.kind = VTK2_INPUT_BUTTON, .button = {button, action, mods}});
 }
 static void _vtk2_ev_damage(GLFWwindow *glfw_win) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
+	atomic_store(&win->damage_all, 1);
 	atomic_flag_clear_explicit(&win->clean, memory_order_release);
+	_vtk2_app_queue(win);
+}
+static void _vtk2_ev_close(GLFWwindow *glfw_win) {
+	// Let the app notice the window has been closed
+	_vtk2_app_queue(glfwGetWindowUserPointer(glfw_win));
 }
 static void _vtk2_ev_enter(GLFWwindow *glfw_win, int entered) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
-	if (win->root && win->root->ev_enter) {
-		win->root->ev_enter(win->root, entered);
-	}
+	_vtk2_input_push(win, (struct vtk2_input){.kind = VTK2_INPUT_ENTER, .entered = entered});
 }
 static void _vtk2_ev_key(GLFWwindow *glfw_win, int key, int scancode, int action, int mods) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
-	if (win->root && win->root->ev_key) {
-		win->root->ev_key(win->root, key, scancode, action, mods);
-	}
+	_vtk2_input_push(win, (struct vtk2_input){.kind = VTK2_INPUT_KEY, .key = {key, scancode, action, mods}});
 }
 static void _vtk2_ev_mouse(GLFWwindow *glfw_win, double x, double y) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
-	if (win->root && win->root->ev_mouse) {
-		win->root->ev_mouse(win->root, x, y, win->cx, win->cy);
+
+	// Only the latest position matters, unless something between two movements needs the one before
+	struct vtk2_input *last = _vtk2_input_last(win, VTK2_INPUT_MOUSE);
+	if (last && !_vtk2_window_raw_motion(win, last->pos[0], last->pos[1])) {
+		last->pos[0] = x;
+		last->pos[1] = y;
+		return;
 	}
-	win->cx = x;
-	win->cy = y;
+	_vtk2_input_push(win, (struct vtk2_input){.kind = VTK2_INPUT_MOUSE, .pos = {x, y}});
 }
 static void _vtk2_ev_resize(GLFWwindow *glfw_win, int fb_w, int fb_h) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
 
 	// Damage window
+	atomic_store(&win->damage_all, 1);
 	atomic_flag_clear_explicit(&win->clean, memory_order_release);
+	_vtk2_app_queue(win);
 
 	// Store framebuffer dimensions
 	win->fb_w = fb_w;
@@ -107,457 +231,3091 @@ static void _vtk2_ev_resize(GLFWwindow *glfw_win, int fb_w, int fb_h) {
 	win->win_w = w;
 	win->win_h = h;
 }
-static void _vtk2_ev_text(GLFWwindow *glfw_win, unsigned rune) {
+static void _vtk2_ev_scroll(GLFWwindow *glfw_win, double dx, double dy) {
 	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
-	if (win->root && win->root->ev_text) {
-		win->root->ev_text(win->root, rune);
+
+	// Scrolls in a row add up to one bigger scroll
+	struct vtk2_input *last = _vtk2_input_last(win, VTK2_INPUT_SCROLL);
+	if (last) {
+		last->delta[0] += dx;
+		last->delta[1] += dy;
+		return;
 	}
+	_vtk2_input_push(win, (struct vtk2_input){.kind = VTK2_INPUT_SCROLL, .delta = {dx, dy}});
+}
+static void _vtk2_ev_text(GLFWwindow *glfw_win, unsigned rune) {
+	struct vtk2_win *win = glfwGetWindowUserPointer(glfw_win);
+	_vtk2_input_push(win, (struct vtk2_input){.kind = VTK2_INPUT_TEXT, .rune = rune});
 }
 
-//// Drawing ////
-static void _vtk2_window_draw(struct vtk2_win *win) {
-	if (atomic_flag_test_and_set_explicit(&win->clean, memory_order_acquire)) return;
+//// Layout workers ////
+#define VTK2_DEQUE_SIZE 256 // Must be a power of two
 
-	float fb_scale = win->win_w / (float)win->fb_w;
+// Arrange a range of a box's children, starting at the position in rect
+struct vtk2_task {
+	struct vtk2_b_box *box;
+	size_t start, end;
+	float rect[4];
+	enum vtk2_shrink shrink;
+	atomic_bool done;
+};
 
-	// Calculate block layout
-	vtk2_block_layout(win->root, (float [4]){0, 0, win->win_w, win->win_h}, VTK2_SHRINK_NONE);
+// State for each thread taking part in a layout
+struct vtk2_worker {
+	struct vtk2_pool *pool;
+	struct vtk2_block *commits; // Blocks laid out by this thread
+#ifdef VTK2_PROFILE
+	struct vtk2_frame_stats stats; // Counts for work done by this thread
+#endif
 
-	glViewport(0, 0, win->fb_w, win->fb_h);
-	glClearColor(0, 0, 0, 0);
-	glClear(GL_COLOR_BUFFER_BIT);
-	nvgBeginFrame(win->vg, win->win_w, win->win_h, fb_scale);
+	// Chase-Lev work-stealing deque; the owner pushes and pops at the bottom, thieves take from the top
+	atomic_llong top, bottom;
+	_Atomic(struct vtk2_task *) tasks[VTK2_DEQUE_SIZE];
+	unsigned victim; // Next worker to try stealing from
+};
 
-	if (win->root && win->root->draw) {
-		win->root->draw(win->root);
-	}
+struct vtk2_pool {
+	size_t nworkers; // Including whichever thread starts each layout, which uses workers[0]
+	thrd_t *threads;
+	mtx_t lock; // Protects quit
+	cnd_t cond; // Signalled when a layout starts, tasks are spawned for sleeping workers, or the pool shuts down
+	_Bool quit;
+	atomic_bool active; // Set while a layout is running
+	atomic_size_t spawned; // Number of tasks pushed so far, so idle workers can tell whether they missed any
+	atomic_size_t sleeping; // Number of workers waiting for tasks
+	struct vtk2_worker workers[];
+};
 
-	nvgEndFrame(win->vg);
-	glfwSwapBuffers(win->win);
+// Worker for the layout running on this thread, if any
+static _Thread_local struct vtk2_worker *_vtk2_worker;
+// List binding rows on this thread, if any
+static _Thread_local struct vtk2_block *_vtk2_binding;
+
+//// Profiling ////
+#ifdef VTK2_PROFILE
+// Monotonic, since wall clock time can jump when the system time is adjusted
+// GLFW's timer isn't usable by headless windows, which never initialize GLFW
+#	if defined(__unix__) || defined(__APPLE__)
+static double _vtk2_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#	else
+static double _vtk2_now(void) {
+	return glfwGetTime();
 }
+#	endif
 
-//// Error handling ////
-const char *vtk2_strerror(enum vtk2_err err) {
-	switch (err) {
-	case VTK2_ERR_SUCCESS:
-		return NULL;
-	case VTK2_ERR_ALLOC:
-		return "allocation failed";
-	case VTK2_ERR_PLATFORM:
-		return "GLFW platform error";
-	case VTK2_ERR_LOAD_FAILED:
-		return "load failed";
+static inline struct vtk2_frame_stats *_vtk2_prof_frame(struct vtk2_win *win) {
+	// Layout threads keep their own counts, which are added to the frame that displays the layout
+	if (_vtk2_worker) return &_vtk2_worker->stats;
+	return &win->stats[win->stats_frame % VTK2_PROFILE_FRAMES];
+}
+
+static void _vtk2_prof_add(struct vtk2_frame_stats *dst, struct vtk2_frame_stats *src) {
+	dst->measure_calls += src->measure_calls;
+	dst->arrange_calls += src->arrange_calls;
+	dst->text_fn_calls += src->text_fn_calls;
+	dst->text_bounds_calls += src->text_bounds_calls;
+	dst->replay_calls += src->replay_calls;
+	for (int i = 0; i < VTK2_PROFILE_KINDS; i++) {
+		dst->draw_calls[i] += src->draw_calls[i];
 	}
+	*src = (struct vtk2_frame_stats){0};
 }
 
-void vtk2_perror(const char *prefix, enum vtk2_err err) {
-	fprintf(stderr, "%s: %s\n", prefix, vtk2_strerror(err));
+static void _vtk2_prof_begin(struct vtk2_win *win) {
+	struct vtk2_frame_stats *f = _vtk2_prof_frame(win);
+	*f = (struct vtk2_frame_stats){0};
+	f->start = win->stats_mark = _vtk2_now();
 }
 
-//// Windowing API ////
-enum vtk2_err vtk2_window_init(struct vtk2_win *win, const char *title, int w, int h) {
-	glfwInit();
+static void _vtk2_prof_end(struct vtk2_win *win) {
+	win->stats_frame++;
+}
 
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// Add the time since the last mark to the specified phase
+static void _vtk2_prof_mark(struct vtk2_win *win, double *phase) {
+	double t = _vtk2_now();
+	*phase += t - win->stats_mark;
+	win->stats_mark = t;
+}
 
-	GLFWwindow *glfw_win = glfwCreateWindow(w, h, title, NULL, NULL);
-	if (!glfw_win) return VTK2_ERR_PLATFORM;
+#	define VTK2_PROF_MARK(win, phase) _vtk2_prof_mark(win, &_vtk2_prof_frame(win)->phase)
+#	define VTK2_PROF_COUNT(win, counter) (_vtk2_prof_frame(win)->counter++)
 
-	enum vtk2_err err = vtk2_window_init_glfw(win, glfw_win);
-	if (err) {
-		glfwDestroyWindow(glfw_win);
+size_t vtk2_window_stats(struct vtk2_win *win, struct vtk2_frame_stats *out, size_t n) {
+	size_t avail = win->stats_frame < VTK2_PROFILE_FRAMES ? win->stats_frame : VTK2_PROFILE_FRAMES;
+	if (n > avail) n = avail;
+	for (size_t i = 0; i < n; i++) {
+		out[i] = win->stats[(win->stats_frame - n + i) % VTK2_PROFILE_FRAMES];
 	}
-	return err;
+	return n;
 }
+#else
+#	define _vtk2_prof_begin(win) ((void)0)
+#	define _vtk2_prof_end(win) ((void)0)
+#	define VTK2_PROF_MARK(win, phase) ((void)0)
+#	define VTK2_PROF_COUNT(win, counter) ((void)0)
+#endif
 
-enum vtk2_err vtk2_window_init_glfw(struct vtk2_win *win, GLFWwindow *glfw_win) {
-	// Start damaged, since we've not drawn anything yet
-	win->clean = (atomic_flag)ATOMIC_FLAG_INIT;
+//// Retained drawing ////
+// Blocks with retain set have the output of their draw callback captured as it reaches the nanovg backend,
+// already tessellated, and replayed directly until the block is damaged or moves
 
-	// Setup window
-	win->win = glfw_win;
-	glfwSetWindowUserPointer(win->win, win);
-	glfwMakeContextCurrent(win->win);
+enum vtk2_draw_kind {
+	VTK2_DRAW_FILL,
+	VTK2_DRAW_STROKE,
+	VTK2_DRAW_TRIANGLES,
+};
 
-	// Create nanovg context
-	win->vg = nvgCreate(0);
-	if (!win->vg) {
-		return VTK2_ERR_ALLOC;
-	}
+struct vtk2_draw_call {
+	enum vtk2_draw_kind kind;
+	NVGpaint paint;
+	NVGcompositeOperationState op;
+	float fringe, stroke_width;
+	float bounds[4];
+	size_t first, count; // Range of paths, or of vertices for triangles
+};
 
-	// Initialize internal properties
-	win->cy = win->cx = NAN;
-	win->root = win->focused = NULL;
+struct vtk2_draw_list {
+	struct vtk2_draw_call *calls;
+	size_t ncalls, calls_cap;
+	NVGpath *paths;
+	size_t (*path_verts)[2]; // Offsets of each path's fill and stroke vertices, until the recording is finished
+	size_t npaths, paths_cap, path_verts_cap;
+	NVGvertex *verts;
+	size_t nverts, verts_cap;
+
+	float rect[4]; // draw_rect the block was recorded at
+	float scale; // Pixel ratio it was recorded at
+	unsigned epoch; // Font atlas epoch it was recorded in
+	_Bool valid;
+	_Bool clipped; // The block draws under a scissor of its own, so can't be replayed anywhere else
+	_Bool failed; // Something went wrong while recording
+};
 
-	// Set up event handlers
-	glfwSetCharCallback(win->win, _vtk2_ev_text);
-	glfwSetCursorEnterCallback(win->win, _vtk2_ev_enter);
-	glfwSetCursorPosCallback(win->win, _vtk2_ev_mouse);
-	glfwSetFramebufferSizeCallback(win->win, _vtk2_ev_resize);
-	glfwSetKeyCallback(win->win, _vtk2_ev_key);
-	glfwSetMouseButtonCallback(win->win, _vtk2_ev_button);
-	glfwSetWindowRefreshCallback(win->win, _vtk2_ev_damage);
+// The original backend functions; every context uses the same backend, so these are shared
+static NVGparams _vtk2_backend;
+// Bumped whenever the font atlas is cleared, which invalidates every recorded glyph
+static atomic_uint _vtk2_atlas_epoch;
+
+// Recording in progress on this thread, and the scissor the block is expected to be drawn with
+static _Thread_local struct vtk2_draw_list *_vtk2_recording;
+static _Thread_local NVGscissor _vtk2_recording_scissor;
+
+#define VTK2_GROW(list, len, cap, n) _vtk2_grow((void **)&(list), &(cap), (len) + (n), sizeof *(list))
+static _Bool _vtk2_grow(void **buf, size_t *cap, size_t len, size_t size) {
+	if (len <= *cap) return 1;
+	size_t new_cap = *cap ? *cap : 16;
+	while (new_cap < len) new_cap *= 2;
+	void *new_buf = realloc(*buf, new_cap * size);
+	if (!new_buf) return 0;
+	*buf = new_buf;
+	*cap = new_cap;
+	return 1;
+}
 
-	// Set initial size
-	int fb_w, fb_h;
-	glfwGetFramebufferSize(win->win, &fb_w, &fb_h);
-	_vtk2_ev_resize(win->win, fb_w, fb_h);
+static struct vtk2_draw_call *_vtk2_record_call(struct vtk2_draw_list *list, enum vtk2_draw_kind kind, NVGpaint *paint, NVGcompositeOperationState op, NVGscissor *scissor, float fringe) {
+	if (list->failed) return NULL;
+	if (memcmp(scissor, &_vtk2_recording_scissor, sizeof *scissor)) {
+		list->clipped = list->failed = 1;
+		return NULL;
+	}
+	if (!VTK2_GROW(list->calls, list->ncalls, list->calls_cap, 1)) {
+		list->failed = 1;
+		return NULL;
+	}
 
-	return 0;
+	struct vtk2_draw_call *call = &list->calls[list->ncalls++];
+	*call = (struct vtk2_draw_call){.kind = kind, .paint = *paint, .op = op, .fringe = fringe};
+	return call;
 }
 
-static void _vtk2_block_deinit(struct vtk2_block *block) {
-	if (!block) return;
-	if (block->deinit) block->deinit(block);
+static _Bool _vtk2_record_verts(struct vtk2_draw_list *list, const NVGvertex *verts, size_t n) {
+	if (!VTK2_GROW(list->verts, list->nverts, list->verts_cap, n)) return 0;
+	memcpy(list->verts + list->nverts, verts, n * sizeof *verts);
+	list->nverts += n;
+	return 1;
 }
 
-void vtk2_window_deinit(struct vtk2_win *win) {
-	_vtk2_block_deinit(win->root);
-	nvgDelete(win->vg);
-	glfwDestroyWindow(win->win);
+static void _vtk2_record_paths(struct vtk2_draw_list *list, struct vtk2_draw_call *call, const NVGpath *paths, int npaths) {
+	if (!VTK2_GROW(list->paths, list->npaths, list->paths_cap, npaths) ||
+		!VTK2_GROW(list->path_verts, list->npaths, list->path_verts_cap, npaths)) {
+		list->failed = 1;
+		return;
+	}
+
+	call->first = list->npaths;
+	call->count = npaths;
+	for (int i = 0; i < npaths; i++) {
+		list->paths[list->npaths] = paths[i];
+		list->path_verts[list->npaths][0] = list->nverts;
+		if (!_vtk2_record_verts(list, paths[i].fill, paths[i].nfill)) list->failed = 1;
+		list->path_verts[list->npaths][1] = list->nverts;
+		if (!_vtk2_record_verts(list, paths[i].stroke, paths[i].nstroke)) list->failed = 1;
+		list->npaths++;
+	}
 }
 
-enum vtk2_err vtk2_window_set_root(struct vtk2_win *win, struct vtk2_block *root) {
-	_vtk2_block_deinit(win->root);
+static void _vtk2_record_fill(void *uptr, NVGpaint *paint, NVGcompositeOperationState op, NVGscissor *scissor, float fringe, const float *bounds, const NVGpath *paths, int npaths) {
+	_vtk2_backend.renderFill(uptr, paint, op, scissor, fringe, bounds, paths, npaths);
+	if (!_vtk2_recording) return;
 
-	// Initialize root block
-	enum vtk2_err err = vtk2_block_init(win, root);
-	if (err == 0) {
-		win->root = root;
-	}
+	struct vtk2_draw_call *call = _vtk2_record_call(_vtk2_recording, VTK2_DRAW_FILL, paint, op, scissor, fringe);
+	if (!call) return;
+	memcpy(call->bounds, bounds, sizeof call->bounds);
+	_vtk2_record_paths(_vtk2_recording, call, paths, npaths);
+}
 
-	return err;
+static void _vtk2_record_stroke(void *uptr, NVGpaint *paint, NVGcompositeOperationState op, NVGscissor *scissor, float fringe, float stroke_width, const NVGpath *paths, int npaths) {
+	_vtk2_backend.renderStroke(uptr, paint, op, scissor, fringe, stroke_width, paths, npaths);
+	if (!_vtk2_recording) return;
+
+	struct vtk2_draw_call *call = _vtk2_record_call(_vtk2_recording, VTK2_DRAW_STROKE, paint, op, scissor, fringe);
+	if (!call) return;
+	call->stroke_width = stroke_width;
+	_vtk2_record_paths(_vtk2_recording, call, paths, npaths);
 }
 
-//// Main loop ////
-void vtk2_window_mainloop(struct vtk2_win *win) {
-	while (!glfwWindowShouldClose(win->win)) {
-		_vtk2_window_draw(win);
-		glfwWaitEvents();
-	}
+static void _vtk2_record_triangles(void *uptr, NVGpaint *paint, NVGcompositeOperationState op, NVGscissor *scissor, const NVGvertex *verts, int nverts, float fringe) {
+	_vtk2_backend.renderTriangles(uptr, paint, op, scissor, verts, nverts, fringe);
+	if (!_vtk2_recording) return;
+
+	struct vtk2_draw_call *call = _vtk2_record_call(_vtk2_recording, VTK2_DRAW_TRIANGLES, paint, op, scissor, fringe);
+	if (!call) return;
+	call->first = _vtk2_recording->nverts;
+	call->count = nverts;
+	if (!_vtk2_record_verts(_vtk2_recording, verts, nverts)) _vtk2_recording->failed = 1;
 }
 
-void vtk2_window_redraw(struct vtk2_win *win) {
-	atomic_flag_clear_explicit(&win->clean, memory_order_release);
-	glfwPostEmptyEvent();
+static int _vtk2_record_update_texture(void *uptr, int image, int x, int y, int w, int h, const unsigned char *data) {
+	// nanovg uploads the whole atlas from the origin only after fontstash clears it and adds its white rect,
+	// at which point glyph coordinates recorded earlier no longer mean anything
+	if (x == 0 && y == 0) atomic_fetch_add(&_vtk2_atlas_epoch, 1);
+	return _vtk2_backend.renderUpdateTexture(uptr, image, x, y, w, h, data);
 }
 
-//// Block functions ////
-enum vtk2_err vtk2_block_init(struct vtk2_win *win, struct vtk2_block *block) {
-	block->win = win;
+static void _vtk2_window_hook_backend(struct vtk2_win *win) {
+	NVGparams *params = nvgInternalParams(win->vg);
+	if (params->renderFill == _vtk2_record_fill) return;
+	_vtk2_backend = *params;
+	params->renderFill = _vtk2_record_fill;
+	params->renderStroke = _vtk2_record_stroke;
+	params->renderTriangles = _vtk2_record_triangles;
+	params->renderUpdateTexture = _vtk2_record_update_texture;
+}
 
-	enum vtk2_err err = 0;
-	if (block->init) {
-		err = block->init(block);
-	}
-	return err;
+static void _vtk2_draw_list_free(struct vtk2_draw_list *list) {
+	if (!list) return;
+	free(list->calls);
+	free(list->paths);
+	free(list->path_verts);
+	free(list->verts);
+	free(list);
 }
 
-static inline float _vtk2_forf(float a, float b) {
-	return isnan(a) ? b : a;
+// The scissor nvgScissor produces for a region of the window
+static void _vtk2_region_scissor(NVGscissor *scissor, const float rect[4]) {
+	*scissor = (NVGscissor){
+		.xform = {1, 0, 0, 1, rect[0] + rect[2] * 0.5f, rect[1] + rect[3] * 0.5f},
+		.extent = {rect[2] * 0.5f, rect[3] * 0.5f},
+	};
 }
-static void _vtk2_block_constrain(struct vtk2_block *block) {
-	float w = block->rect[2], h = block->rect[3];
 
-	if (block->grow == 0) {
-		w = _vtk2_forf(block->size[0], w);
-		h = _vtk2_forf(block->size[1], h);
-	} else {
-		w = fmaxf(block->size[0], w);
-		h = fmaxf(block->size[1], h);
+static _Bool _vtk2_draw_list_replay(struct vtk2_block *block, struct vtk2_draw_list *list) {
+	struct vtk2_win *win = block->win;
+	if (!list->valid) return 0;
+	if (list->epoch != atomic_load(&_vtk2_atlas_epoch)) return 0;
+	if (list->scale != win->win_w / (float)win->fb_w) return 0;
+	if (memcmp(list->rect, block->draw_rect, sizeof list->rect)) return 0;
+
+	// Make sure every texture we refer to still exists
+	NVGparams *params = nvgInternalParams(win->vg);
+	for (size_t i = 0; i < list->ncalls; i++) {
+		int w, h, image = list->calls[i].paint.image;
+		if (image && !_vtk2_backend.renderGetTextureSize(params->userPtr, image, &w, &h)) return 0;
 	}
 
-	block->rect[2] = fmaxf(0, w);
-	block->rect[3] = fmaxf(0, h);
+	NVGscissor scissor;
+	_vtk2_region_scissor(&scissor, win->clip);
+	for (size_t i = 0; i < list->ncalls; i++) {
+		struct vtk2_draw_call *call = &list->calls[i];
+		switch (call->kind) {
+		case VTK2_DRAW_FILL:
+			_vtk2_backend.renderFill(params->userPtr, &call->paint, call->op, &scissor, call->fringe, call->bounds, list->paths + call->first, call->count);
+			break;
+		case VTK2_DRAW_STROKE:
+			_vtk2_backend.renderStroke(params->userPtr, &call->paint, call->op, &scissor, call->fringe, call->stroke_width, list->paths + call->first, call->count);
+			break;
+		case VTK2_DRAW_TRIANGLES:
+			_vtk2_backend.renderTriangles(params->userPtr, &call->paint, call->op, &scissor, list->verts + call->first, call->count, call->fringe);
+			break;
+		}
+	}
+	return 1;
 }
 
-void vtk2_block_layout(struct vtk2_block *block, float rect[4], enum vtk2_shrink shrink) {
-	if (!block) return;
+static void _vtk2_block_draw_retained(struct vtk2_block *block) {
+	struct vtk2_draw_list *list = block->retained;
+	if (list && list->clipped) {
+		block->type->draw(block);
+		return;
+	}
+	if (list && _vtk2_draw_list_replay(block, list)) {
+		VTK2_PROF_COUNT(block->win, replay_calls);
+		return;
+	}
 
-	// Compute margins
-	float mx = block->margins[0];
-	float my = block->margins[1];
-	float mw = block->margins[2] + mx;
-	float mh = block->margins[3] + my;
+	if (!list && !(list = block->retained = calloc(1, sizeof *list))) {
+		block->type->draw(block);
+		return;
+	}
 
-	// Set initial rect size
-	block->rect[0] = rect[0] + mx;
-	block->rect[1] = rect[1] + my;
-	block->rect[2] = fmaxf(0, rect[2] - mw);
-	block->rect[3] = fmaxf(0, rect[3] - mh);
+	// Record the block as it draws
+	struct vtk2_draw_list *outer = _vtk2_recording;
+	NVGscissor outer_scissor = _vtk2_recording_scissor;
+	if (outer) outer->failed = 1; // Our calls bypass the outer recording, so it would be incomplete
+
+	list->ncalls = list->npaths = list->nverts = 0;
+	list->valid = list->failed = 0;
+	list->epoch = atomic_load(&_vtk2_atlas_epoch);
+	_vtk2_region_scissor(&_vtk2_recording_scissor, block->win->clip);
+	_vtk2_recording = list;
+	block->type->draw(block);
+	_vtk2_recording = outer;
+	_vtk2_recording_scissor = outer_scissor;
+
+	if (list->failed || list->epoch != atomic_load(&_vtk2_atlas_epoch)) return;
+	for (size_t i = 0; i < list->npaths; i++) {
+		list->paths[i].fill = list->verts + list->path_verts[i][0];
+		list->paths[i].stroke = list->verts + list->path_verts[i][1];
+	}
+	memcpy(list->rect, block->draw_rect, sizeof list->rect);
+	list->scale = block->win->win_w / (float)block->win->fb_w;
+	list->valid = 1;
+}
 
-	// Compute layout
-	if (block->layout) {
-		block->layout(block, shrink);
+static inline void _vtk2_block_draw(struct vtk2_block *block) {
+#ifdef VTK2_PROFILE
+	enum vtk2_profile_kind kind = VTK2_PROFILE_OTHER;
+	if (block->type == &_vtk2_box_type) kind = VTK2_PROFILE_BOX;
+	else if (block->type == &_vtk2_static_text_type) kind = VTK2_PROFILE_STATIC_TEXT;
+	else if (block->type == &_vtk2_text_type) kind = VTK2_PROFILE_TEXT;
+	else if (block->type == &_vtk2_list_type) kind = VTK2_PROFILE_LIST;
+	VTK2_PROF_COUNT(block->win, draw_calls[kind]);
+#endif
+	if (block->type->retain) {
+		_vtk2_block_draw_retained(block);
 	} else {
-		// Default, very simple sizing algorithm
-		_vtk2_block_constrain(block);
+		block->type->draw(block);
 	}
 }
 
-//// Box block ////
-static enum vtk2_err _vtk2_box_init(struct vtk2_block *base) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+//// Damage tracking ////
+static inline _Bool _vtk2_rect_empty(const float r[4]) {
+	return !(r[2] > 0 && r[3] > 0);
+}
+static inline _Bool _vtk2_rect_intersects(const float a[4], const float b[4]) {
+	return a[0] < b[0] + b[2] && b[0] < a[0] + a[2] && a[1] < b[1] + b[3] && b[1] < a[1] + a[3];
+}
+static inline _Bool _vtk2_rect_contains(const float a[4], const float b[4]) {
+	return a[0] <= b[0] && a[1] <= b[1] && b[0] + b[2] <= a[0] + a[2] && b[1] + b[3] <= a[1] + a[3];
+}
+// Matches the test used to find the child under the cursor, so touching rects don't both have the point
+static inline _Bool _vtk2_rect_has_point(const float r[4], float x, float y) {
+	return r[0] <= x && x < r[0] + r[2] && r[1] <= y && y < r[1] + r[3];
+}
+static void _vtk2_rect_union(float out[4], const float a[4], const float b[4]) {
+	float x0 = fminf(a[0], b[0]), y0 = fminf(a[1], b[1]);
+	float x1 = fmaxf(a[0] + a[2], b[0] + b[2]), y1 = fmaxf(a[1] + a[3], b[1] + b[3]);
+	out[0] = x0;
+	out[1] = y0;
+	out[2] = x1 - x0;
+	out[3] = y1 - y0;
+}
 
-	for (struct vtk2_block **child = box->children; child && *child; child++) {
-		enum vtk2_err err = vtk2_block_init(box->base.win, *child);
-		if (err) return err;
+// Add a region to be redrawn this frame. Must be called from the main thread
+static void _vtk2_window_damage(struct vtk2_win *win, const float rect[4]) {
+	if (_vtk2_rect_empty(rect)) return;
+
+	// Round out to whole units, leaving room for antialiasing
+	float x0 = floorf(rect[0]) - 1, y0 = floorf(rect[1]) - 1;
+	float r[4] = {x0, y0, ceilf(rect[0] + rect[2]) + 1 - x0, ceilf(rect[1] + rect[3]) + 1 - y0};
+
+	// Merge with any overlapping regions
+	for (int i = 0; i < win->ndamage;) {
+		float *d = win->damage[i];
+		if (_vtk2_rect_contains(d, r)) return;
+		if (_vtk2_rect_intersects(d, r)) {
+			_vtk2_rect_union(r, r, d);
+			memcpy(d, win->damage[--win->ndamage], sizeof *win->damage);
+			i = 0;
+		} else {
+			i++;
+		}
 	}
-	return 0;
-}
 
-static void _vtk2_box_deinit(struct vtk2_block *base) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
-	for (struct vtk2_block **child = box->children; child && *child; child++) {
-		if ((*child)->deinit) {
-			(*child)->deinit(*child);
+	if (win->ndamage < VTK2_MAX_DAMAGE) {
+		memcpy(win->damage[win->ndamage++], r, sizeof r);
+		return;
+	}
+
+	// Out of space, so merge into whichever region grows the least
+	int best = 0;
+	float best_area = INFINITY;
+	for (int i = 0; i < win->ndamage; i++) {
+		float u[4];
+		_vtk2_rect_union(u, r, win->damage[i]);
+		float area = u[2] * u[3] - win->damage[i][2] * win->damage[i][3];
+		if (area < best_area) {
+			best = i;
+			best_area = area;
 		}
 	}
+	_vtk2_rect_union(win->damage[best], r, win->damage[best]);
 }
 
-static inline float _vtk2_block_dimsize(struct vtk2_block *block, int dim) {
-	return block->rect[2 + dim] + block->margins[dim] + block->margins[2 + dim];
+//// Update queue ////
+// Intrusive MPSC queue (Vyukov): producers swap themselves in at the head, the main thread takes from the tail
+static void _vtk2_update_push(struct vtk2_win *win, struct vtk2_update *update) {
+	atomic_store_explicit(&update->next, NULL, memory_order_relaxed);
+	struct vtk2_update *prev = atomic_exchange_explicit(&win->updates_head, update, memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, update, memory_order_release);
 }
-// FIXME: This is O(2^n) on nesting depth. That is bad, and I should feel bad
-static void _vtk2_box_layout(struct vtk2_block *base, enum vtk2_shrink shrink) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
 
-	int dim = box->direction;
-	enum vtk2_shrink box_shrink = VTK2_SHRINK_X + dim;
+// Returns NULL if the queue is empty, or the next update is still being posted
+static struct vtk2_update *_vtk2_update_pop(struct vtk2_win *win) {
+	struct vtk2_update *tail = win->updates_tail;
+	struct vtk2_update *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (tail == &win->updates_stub) {
+		if (!next) return NULL;
+		win->updates_tail = tail = next;
+		next = atomic_load_explicit(&next->next, memory_order_acquire);
+	}
+	if (next) {
+		win->updates_tail = next;
+		return tail;
+	}
 
-	_vtk2_block_constrain(&box->base);
+	// tail is the last update, but can only be taken once something follows it
+	if (tail != atomic_load_explicit(&win->updates_head, memory_order_acquire)) return NULL;
+	_vtk2_update_push(win, &win->updates_stub);
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (!next) return NULL;
+	win->updates_tail = next;
+	return tail;
+}
 
-	// Compute minimum sizes
-	float rect[4] = {UNPACK_4(box->base.rect)};
-	float cross = 0, grow_total = 0;
-	for (struct vtk2_block **child = box->children; child && *child; child++) {
-		vtk2_block_layout(*child, rect, box_shrink);
+static enum vtk2_err _vtk2_post(struct vtk2_block *block, struct vtk2_update update, const char *text, size_t len) {
+	struct vtk2_update *u = malloc(sizeof *u + (text ? len + 1 : 0));
+	if (!u) return VTK2_ERR_ALLOC;
+	*u = update;
+	u->block = block;
+	if (text) {
+		u->text = (char *)(u + 1);
+		memcpy(u->text, text, len);
+		u->text[len] = 0;
+		u->len = len;
+	}
 
-		float csize = _vtk2_block_dimsize(*child, dim);
-		rect[dim] += csize;
-		rect[2 + dim] -= csize;
+	_vtk2_update_push(block->win, u);
+	vtk2_window_update(block->win);
+	return 0;
+}
 
-		cross = fmax(cross, _vtk2_block_dimsize(*child, 1 - dim));
-		grow_total += (*child)->grow;
+static float *_vtk2_block_font_color(struct vtk2_block *block) {
+	if (block->type == &_vtk2_static_text_type) {
+		return fieldParentPtr(struct vtk2_b_static_text, base, block)->font_color;
+	} else if (block->type == &_vtk2_text_type) {
+		return fieldParentPtr(struct vtk2_b_text, base, block)->font_color;
 	}
+	return NULL;
+}
 
-	if (shrink == box_shrink) {
-		float *size = &box->base.rect[2 + dim];
-		*size -= fmaxf(0, rect[2 + dim]); // Remove leftover space
-		_vtk2_block_constrain(&box->base);
-	} else {
-		if (shrink != VTK2_SHRINK_NONE) {
-			// Shrink cross size
-			box->base.rect[3 - dim] = fmin(box->base.rect[3 - dim], cross);
-			_vtk2_block_constrain(&box->base);
-		}
-
-		// Divide leftover space
-		float unit = grow_total == 0 ? 0 : rect[2 + dim] / grow_total;
+// Cancel any queued updates to root or its descendants, eg. because they are going away
+// Updates can't be unlinked from the middle of the queue, so they are left for apply to skip
+static void _vtk2_window_drop_subtree_updates(struct vtk2_win *win, struct vtk2_block *root) {
+	struct vtk2_update *u = win->updates_tail;
+	for (; u; u = atomic_load_explicit(&u->next, memory_order_acquire)) {
+		if (u == &win->updates_stub) continue;
+		struct vtk2_block *b = u->block;
+		while (b && b != root) b = b->parent;
+		if (b) u->block = NULL;
+	}
+}
 
-		memcpy(rect, box->base.rect, sizeof rect);
-		for (struct vtk2_block **child = box->children; child && *child; child++) {
-			// Set rect size, allocating extra space based on grow factor
-			rect[2 + dim] = _vtk2_block_dimsize(*child, dim) + unit * (*child)->grow;
+// Apply every update posted so far, in order. Must be called while blocks can safely change
+static void _vtk2_window_apply_updates(struct vtk2_win *win) {
+	struct vtk2_update *u;
+	while ((u = _vtk2_update_pop(win))) {
+		struct vtk2_block *block = u->block;
+		if (!block) {
+			// Cancelled because the block was removed
+			free(u);
+			continue;
+		}
 
-			vtk2_block_layout(*child, rect, shrink);
-			rect[dim] += _vtk2_block_dimsize(*child, dim);
+		float *color;
+		switch (u->kind) {
+		case VTK2_UPDATE_TEXT:
+			// There's no one to report failure to, so the block keeps its old text
+			vtk2_text_set(block, u->text, u->len);
+			break;
+		case VTK2_UPDATE_COLOR:
+			if ((color = _vtk2_block_font_color(block))) {
+				memcpy(color, u->color, sizeof u->color);
+			}
+			vtk2_block_invalidate(block);
+			break;
+		case VTK2_UPDATE_SIZE:
+			memcpy(block->size, u->size, sizeof block->size);
+			vtk2_block_invalidate(block);
+			break;
+		case VTK2_UPDATE_INVALIDATE:
+			vtk2_block_invalidate(block);
+			break;
+		case VTK2_UPDATE_FN:
+			u->fn(block, u->data);
+			break;
 		}
+		free(u);
 	}
 }
 
-#ifdef VTK2_BOX_DEBUG
-// SplitMix64
-static uint64_t splitmix64(uint64_t x) {
-	x += 0x9e3779b97f4a7c15;
-	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
-	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
-	return x ^ (x >> 31);
+// Discard any updates that haven't been applied yet
+static void _vtk2_window_drop_updates(struct vtk2_win *win) {
+	struct vtk2_update *u;
+	while ((u = _vtk2_update_pop(win))) free(u);
 }
-#endif
 
-static void _vtk2_box_draw(struct vtk2_block *base) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+enum vtk2_err vtk2_post_text(struct vtk2_block *block, const char *str, size_t len) {
+	if (len == SIZE_MAX) len = strlen(str);
+	return _vtk2_post(block, (struct vtk2_update){.kind = VTK2_UPDATE_TEXT}, str, len);
+}
 
-#ifdef VTK2_BOX_DEBUG
-	struct vtk2_win *win = box->base.win;
-	uint64_t color = splitmix64(splitmix64((uint64_t)&box->base));
-	uint8_t r = (color >> 0) & 0xff;
-	uint8_t g = (color >> 8) & 0xff;
-	uint8_t b = (color >> 16) & 0xff;
-	uint8_t a = 255;
+enum vtk2_err vtk2_post_color(struct vtk2_block *block, const float color[4]) {
+	return _vtk2_post(block, (struct vtk2_update){.kind = VTK2_UPDATE_COLOR, .color = {UNPACK_4(color)}}, NULL, 0);
+}
 
-	nvgBeginPath(win->vg);
-	nvgRect(win->vg, box->base.rect[0], box->base.rect[1], box->base.rect[2], box->base.rect[3]);
-	nvgFillColor(win->vg, nvgRGBA(r, g, b, a));
-	nvgFill(win->vg);
-	nvgStrokeColor(win->vg, nvgRGBA(255, 255, 255, 150));
-	nvgStrokeWidth(win->vg, 1);
-	nvgStroke(win->vg);
-#endif
+enum vtk2_err vtk2_post_size(struct vtk2_block *block, const float size[2]) {
+	return _vtk2_post(block, (struct vtk2_update){.kind = VTK2_UPDATE_SIZE, .size = {UNPACK_2(size)}}, NULL, 0);
+}
 
-	for (struct vtk2_block **child = box->children; child && *child; child++) {
-		if ((*child)->draw) {
-			(*child)->draw(*child);
-		}
+enum vtk2_err vtk2_post_invalidate(struct vtk2_block *block) {
+	return _vtk2_post(block, (struct vtk2_update){.kind = VTK2_UPDATE_INVALIDATE}, NULL, 0);
+}
+
+enum vtk2_err vtk2_post_fn(struct vtk2_block *block, void (*fn)(struct vtk2_block *block, void *data), void *data) {
+	return _vtk2_post(block, (struct vtk2_update){.kind = VTK2_UPDATE_FN, .fn = fn, .data = data}, NULL, 0);
+}
+
+//// Polling ////
+// Register a function to be called on the block at the start of every frame
+static enum vtk2_err _vtk2_window_add_poll(struct vtk2_win *win, struct vtk2_block *block, void (*fn)(struct vtk2_block *)) {
+	if (win->npolls == win->polls_cap) {
+		size_t cap = win->polls_cap ? 2 * win->polls_cap : 16;
+		struct vtk2_poll *polls = realloc(win->polls, cap * sizeof *polls);
+		if (!polls) return VTK2_ERR_ALLOC;
+		win->polls = polls;
+		win->polls_cap = cap;
+	}
+	win->polls[win->npolls++] = (struct vtk2_poll){block, fn};
+	return 0;
+}
+
+static void _vtk2_window_remove_poll(struct vtk2_win *win, struct vtk2_block *block) {
+	for (size_t i = 0; i < win->npolls; i++) {
+		if (win->polls[i].block == block) {
+			win->polls[i] = win->polls[--win->npolls];
+			return;
+		}
+	}
+}
+
+static void _vtk2_window_poll(struct vtk2_win *win) {
+	_vtk2_window_apply_updates(win);
+	for (size_t i = 0; i < win->npolls; i++) {
+		win->polls[i].fn(win->polls[i].block);
+	}
+}
+
+//// Layout ////
+static void _vtk2_block_invalidate_layers(struct vtk2_block *block);
+
+// Drop the cached hover path, so the next cursor movement finds it again from the root
+static void _vtk2_window_forget_hover(struct vtk2_win *win) {
+	win->hover = NULL;
+	win->hover_gen++;
+}
+
+// Make the results of the last layout visible, damaging everything that changed
+static void _vtk2_window_commit(struct vtk2_win *win) {
+#ifdef VTK2_PROFILE
+	_vtk2_prof_add(_vtk2_prof_frame(win), &win->layout_stats);
+#endif
+
+	struct vtk2_block *block = win->commits;
+	win->commits = NULL;
+	while (block) {
+		struct vtk2_block *next = block->commit_next;
+		block->commit_next = NULL;
+		block->queued = 0;
+
+		if (block->retained && block->redraw) block->retained->valid = 0;
+		if (memcmp(block->draw_rect, block->rect, sizeof block->rect)) {
+			_vtk2_window_forget_hover(win); // The path under the cursor may have changed
+			_vtk2_window_damage(win, block->draw_rect);
+			memcpy(block->draw_rect, block->rect, sizeof block->draw_rect);
+			_vtk2_window_damage(win, block->rect);
+			_vtk2_block_invalidate_layers(block);
+		} else if (block->redraw) {
+			_vtk2_window_damage(win, block->rect);
+			_vtk2_block_invalidate_layers(block);
+		}
+		block->redraw = 0;
+
+		if (block->type->commit) block->type->commit(block);
+		block = next;
+	}
+}
+
+// Forget about uncommitted layout results for a block and everything inside it, eg. because it is being removed
+static void _vtk2_window_drop_subtree_commits(struct vtk2_win *win, struct vtk2_block *root) {
+	for (struct vtk2_block **p = &win->commits; *p;) {
+		struct vtk2_block *block = *p, *b = block;
+		while (b && b != root) b = b->parent;
+		if (!b) {
+			p = &block->commit_next;
+			continue;
+		}
+		*p = block->commit_next;
+		block->commit_next = NULL;
+		block->queued = block->redraw = 0;
+	}
+}
+
+// Forget about any layout results that haven't been committed, eg. because the blocks are going away
+static void _vtk2_window_drop_commits(struct vtk2_win *win) {
+	while (win->commits) {
+		struct vtk2_block *block = win->commits;
+		win->commits = block->commit_next;
+		block->commit_next = NULL;
+		block->queued = block->redraw = 0;
+	}
+}
+
+enum {
+	VTK2_LAYOUT_IDLE,
+	VTK2_LAYOUT_RUNNING,
+	VTK2_LAYOUT_DONE, // Finished, but not yet committed
+};
+
+static int _vtk2_layout_thread(void *arg) {
+	struct vtk2_win *win = arg;
+	mtx_lock(&win->layout_wait);
+	for (;;) {
+		while (!win->layout_quit && atomic_load(&win->layout_state) != VTK2_LAYOUT_RUNNING) {
+			cnd_wait(&win->layout_cond, &win->layout_wait);
+		}
+		if (win->layout_quit) break;
+		float rect[4] = {UNPACK_4(win->layout_job)};
+		mtx_unlock(&win->layout_wait);
+
+		mtx_lock(&win->layout_lock);
+		vtk2_block_layout(win->root, rect, VTK2_SHRINK_NONE);
+		mtx_unlock(&win->layout_lock);
+
+		atomic_store(&win->layout_state, VTK2_LAYOUT_DONE);
+		vtk2_window_update(win);
+		mtx_lock(&win->layout_wait);
+	}
+	mtx_unlock(&win->layout_wait);
+	return 0;
+}
+
+// Pick up the results of the last asynchronous layout, and start another if anything changed
+static void _vtk2_window_layout_async(struct vtk2_win *win, const float rect[4]) {
+	int state = atomic_load(&win->layout_state);
+	if (state == VTK2_LAYOUT_DONE) {
+		_vtk2_window_commit(win);
+		atomic_store(&win->layout_state, state = VTK2_LAYOUT_IDLE);
+	}
+	// If a layout is still running, keep drawing the last one
+	if (state != VTK2_LAYOUT_IDLE) return;
+
+	// The layout thread is idle, so blocks can safely change
+	_vtk2_window_poll(win);
+	VTK2_PROF_MARK(win, poll);
+
+	if (!win->root) return;
+	if (!atomic_load(&win->root->dirty) && !memcmp(rect, win->layout_job, sizeof win->layout_job)) return;
+
+	mtx_lock(&win->layout_wait);
+	memcpy(win->layout_job, rect, sizeof win->layout_job);
+	atomic_store(&win->layout_state, VTK2_LAYOUT_RUNNING);
+	cnd_signal(&win->layout_cond);
+	mtx_unlock(&win->layout_wait);
+}
+
+enum vtk2_err vtk2_window_async_layout(struct vtk2_win *win) {
+	if (win->async) return 0;
+	win->layout_quit = 0;
+	win->layout_job[0] = NAN; // Never matches, so the first frame always starts a layout
+	atomic_store(&win->layout_state, VTK2_LAYOUT_IDLE);
+	if (cnd_init(&win->layout_cond) != thrd_success) return VTK2_ERR_PLATFORM;
+	if (thrd_create(&win->layout_thread, _vtk2_layout_thread, win) != thrd_success) {
+		cnd_destroy(&win->layout_cond);
+		return VTK2_ERR_PLATFORM;
+	}
+	win->async = 1;
+	return 0;
+}
+
+static void _vtk2_window_stop_layout(struct vtk2_win *win) {
+	if (!win->async) return;
+	mtx_lock(&win->layout_wait);
+	win->layout_quit = 1;
+	cnd_signal(&win->layout_cond);
+	mtx_unlock(&win->layout_wait);
+	thrd_join(win->layout_thread, NULL);
+	cnd_destroy(&win->layout_cond);
+	win->async = 0;
+}
+
+void vtk2_window_lock(struct vtk2_win *win) {
+	mtx_lock(&win->layout_lock);
+}
+
+void vtk2_window_unlock(struct vtk2_win *win) {
+	mtx_unlock(&win->layout_lock);
+}
+
+//// Drawing ////
+// Draw the block tree, clipped to the specified region
+static void _vtk2_window_draw_region(struct vtk2_win *win, const float rect[4]) {
+	memcpy(win->clip, rect, sizeof win->clip);
+	if (win->root && win->root->type->draw) {
+		_vtk2_block_draw(win->root);
+	}
+}
+
+static void _vtk2_window_make_current(struct vtk2_win *win);
+static void _vtk2_box_render_layer(struct vtk2_b_box *box);
+static void _vtk2_window_render(struct vtk2_win *win) {
+
+	float fb_scale = win->win_w / (float)win->fb_w;
+	float px_x = win->fb_w / win->win_w, px_y = win->fb_h / win->win_h;
+	float full[4] = {0, 0, win->win_w, win->win_h};
+
+	// Deliver input and let blocks check for changes, then calculate block layout, collecting damage from any blocks that changed
+	_vtk2_window_dispatch_input(win);
+	_Bool damage_all = atomic_exchange(&win->damage_all, 0);
+	if (win->async) {
+		_vtk2_window_layout_async(win, full);
+	} else {
+		_vtk2_window_poll(win);
+		VTK2_PROF_MARK(win, poll);
+		vtk2_block_layout(win->root, full, VTK2_SHRINK_NONE);
+		_vtk2_window_commit(win);
+	}
+	VTK2_PROF_MARK(win, layout);
+
+	// Text may be measured on the layout thread while we draw
+	mtx_lock(&win->vg_lock);
+
+	// (Re)create the back buffer if needed
+	if (win->fb) {
+		int w, h;
+		nvgImageSize(win->vg, win->fb->image, &w, &h);
+		if ((uint32_t)w != win->fb_w || (uint32_t)h != win->fb_h) {
+			nvgluDeleteFramebuffer(win->fb);
+			win->fb = NULL;
+		}
+	}
+	if (!win->fb) {
+		win->fb = nvgluCreateFramebuffer(win->vg, win->fb_w, win->fb_h, 0);
+		damage_all = 1;
+	}
+
+	if (damage_all || !win->fb) {
+		win->ndamage = 0;
+		_vtk2_window_damage(win, full);
+	} else if (win->ndamage == 0) {
+		// Nothing visible changed
+		mtx_unlock(&win->vg_lock);
+		return;
+	}
+
+	// Bring layers up to date before drawing anything that might show them
+	for (struct vtk2_b_box *box = win->layers; box; box = box->layer_next) {
+		if (!box->layer_valid) _vtk2_box_render_layer(box);
+	}
+
+	// Draw damaged regions into the back buffer, leaving the rest untouched
+	nvgluBindFramebuffer(win->fb);
+	glViewport(0, 0, win->fb_w, win->fb_h);
+	glClearColor(0, 0, 0, 0);
+	glEnable(GL_SCISSOR_TEST);
+	for (int i = 0; i < win->ndamage; i++) {
+		float *d = win->damage[i];
+		int x0 = floorf(d[0] * px_x), y0 = floorf(d[1] * px_y);
+		int x1 = ceilf((d[0] + d[2]) * px_x), y1 = ceilf((d[1] + d[3]) * px_y);
+		glScissor(x0, (int)win->fb_h - y1, x1 - x0, y1 - y0);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glDisable(GL_SCISSOR_TEST);
+
+	nvgBeginFrame(win->vg, win->win_w, win->win_h, fb_scale);
+	for (int i = 0; i < win->ndamage; i++) {
+		float *d = win->damage[i];
+		nvgSave(win->vg);
+		nvgScissor(win->vg, UNPACK_4(d));
+		_vtk2_window_draw_region(win, d);
+		nvgRestore(win->vg);
+	}
+	VTK2_PROF_MARK(win, draw);
+	nvgEndFrame(win->vg);
+	VTK2_PROF_MARK(win, flush);
+	win->ndamage = 0;
+
+	// Headless windows have nowhere else to put the frame
+	if (!win->win) {
+		mtx_unlock(&win->vg_lock);
+		return;
+	}
+
+	// Copy the back buffer to the window
+	if (win->fb) {
+		nvgluBindFramebuffer(NULL);
+		glViewport(0, 0, win->fb_w, win->fb_h);
+		glClear(GL_COLOR_BUFFER_BIT);
+		nvgBeginFrame(win->vg, win->win_w, win->win_h, fb_scale);
+		nvgBeginPath(win->vg);
+		nvgRect(win->vg, UNPACK_4(full));
+		nvgFillPaint(win->vg, nvgImagePattern(win->vg, UNPACK_4(full), 0, win->fb->image, 1));
+		nvgFill(win->vg);
+		nvgEndFrame(win->vg);
+	}
+	mtx_unlock(&win->vg_lock);
+
+	glfwSwapBuffers(win->win);
+	VTK2_PROF_MARK(win, swap);
+}
+
+_Bool vtk2_window_draw(struct vtk2_win *win) {
+	if (atomic_flag_test_and_set_explicit(&win->clean, memory_order_acquire)) return 0;
+	_vtk2_window_make_current(win);
+
+	_vtk2_prof_begin(win);
+	_vtk2_window_render(win);
+	_vtk2_prof_end(win);
+	return 1;
+}
+
+//// Error handling ////
+const char *vtk2_strerror(enum vtk2_err err) {
+	switch (err) {
+	case VTK2_ERR_SUCCESS:
+		return NULL;
+	case VTK2_ERR_ALLOC:
+		return "allocation failed";
+	case VTK2_ERR_PLATFORM:
+		return "GLFW platform error";
+	case VTK2_ERR_LOAD_FAILED:
+		return "load failed";
+	}
+}
+
+void vtk2_perror(const char *prefix, enum vtk2_err err) {
+	fprintf(stderr, "%s: %s\n", prefix, vtk2_strerror(err));
+}
+
+//// Windowing API ////
+enum vtk2_err vtk2_window_init(struct vtk2_win *win, const char *title, int w, int h) {
+	glfwInit();
+
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	GLFWwindow *glfw_win = glfwCreateWindow(w, h, title, NULL, NULL);
+	if (!glfw_win) return VTK2_ERR_PLATFORM;
+
+	enum vtk2_err err = vtk2_window_init_glfw(win, glfw_win);
+	if (err) {
+		glfwDestroyWindow(glfw_win);
+	}
+	return err;
+}
+
+// Set up everything that doesn't depend on the platform. The GL context must be current
+static enum vtk2_err _vtk2_window_setup(struct vtk2_win *win) {
+	// Start damaged, since we've not drawn anything yet
+	win->clean = (atomic_flag)ATOMIC_FLAG_INIT;
+	atomic_init(&win->damage_all, 1);
+	win->ndamage = 0;
+	win->fb = NULL;
+	win->text_cache = NULL;
+	win->text_cache_cap = win->text_cache_len = 0;
+	win->polls = NULL;
+	win->npolls = win->polls_cap = 0;
+	win->input = NULL;
+	win->ninput = win->input_cap = 0;
+	win->commits = NULL;
+	win->async = 0;
+	atomic_init(&win->layout_state, 0);
+	enum vtk2_err err = VTK2_ERR_PLATFORM;
+	if (mtx_init(&win->layout_lock, mtx_plain) != thrd_success) goto fail;
+	if (mtx_init(&win->layout_wait, mtx_plain) != thrd_success) goto fail_layout_lock;
+	if (mtx_init(&win->vg_lock, mtx_plain) != thrd_success) goto fail_layout_wait;
+	if (mtx_init(&win->text_lock, mtx_plain) != thrd_success) goto fail_vg_lock;
+	win->pool = NULL;
+	win->layers = NULL;
+	atomic_init(&win->wake_posted, 0);
+	atomic_init(&win->frame_deadline, 0);
+	win->frame_interval = 0;
+	win->frame_next = 0;
+	win->frame_fn = NULL;
+	win->frame_data = NULL;
+	atomic_init(&win->updates_stub.next, NULL);
+	atomic_init(&win->updates_head, &win->updates_stub);
+	win->updates_tail = &win->updates_stub;
+	win->app = NULL;
+	atomic_init(&win->app_queued, 0);
+	win->app_next = NULL;
+#ifdef VTK2_PROFILE
+	win->stats_frame = 0;
+	win->layout_stats = (struct vtk2_frame_stats){0};
+#endif
+
+	// Create nanovg context
+	win->vg = nvgCreate(0);
+	if (!win->vg) {
+		err = VTK2_ERR_ALLOC;
+		goto fail_text_lock;
+	}
+	_vtk2_window_hook_backend(win);
+
+	// Initialize internal properties
+	win->cy = win->cx = NAN;
+	win->root = win->focused = win->hover = NULL;
+	win->hover_gen = 0;
+
+	return 0;
+
+fail_text_lock:
+	mtx_destroy(&win->text_lock);
+fail_vg_lock:
+	mtx_destroy(&win->vg_lock);
+fail_layout_wait:
+	mtx_destroy(&win->layout_wait);
+fail_layout_lock:
+	mtx_destroy(&win->layout_lock);
+fail:
+	return err;
+}
+
+// Free what _vtk2_window_setup created
+static void _vtk2_window_unsetup(struct vtk2_win *win) {
+	nvgDelete(win->vg);
+	mtx_destroy(&win->text_lock);
+	mtx_destroy(&win->vg_lock);
+	mtx_destroy(&win->layout_wait);
+	mtx_destroy(&win->layout_lock);
+}
+
+enum vtk2_err vtk2_window_init_glfw(struct vtk2_win *win, GLFWwindow *glfw_win) {
+	// Setup window
+	win->win = glfw_win;
+	win->egl_display = win->egl_context = NULL;
+	glfwSetWindowUserPointer(win->win, win);
+	glfwMakeContextCurrent(win->win);
+	glfwSwapInterval(1);
+
+	enum vtk2_err err = _vtk2_window_setup(win);
+	if (err) return err;
+
+	// Set up event handlers
+	glfwSetCharCallback(win->win, _vtk2_ev_text);
+	glfwSetWindowCloseCallback(win->win, _vtk2_ev_close);
+	glfwSetCursorEnterCallback(win->win, _vtk2_ev_enter);
+	glfwSetCursorPosCallback(win->win, _vtk2_ev_mouse);
+	glfwSetFramebufferSizeCallback(win->win, _vtk2_ev_resize);
+	glfwSetKeyCallback(win->win, _vtk2_ev_key);
+	glfwSetMouseButtonCallback(win->win, _vtk2_ev_button);
+	glfwSetScrollCallback(win->win, _vtk2_ev_scroll);
+	glfwSetWindowRefreshCallback(win->win, _vtk2_ev_damage);
+	vtk2_window_set_max_fps(win, 0);
+
+	// Set initial size
+	int fb_w, fb_h;
+	glfwGetFramebufferSize(win->win, &fb_w, &fb_h);
+	_vtk2_ev_resize(win->win, fb_w, fb_h);
+
+	return 0;
+}
+
+#ifdef VTK2_HEADLESS
+enum vtk2_err vtk2_window_init_headless(struct vtk2_win *win, int w, int h) {
+	// Prefer Mesa's surfaceless platform, which needs no display server
+	EGLDisplay dpy = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (dpy == EGL_NO_DISPLAY) dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, NULL, NULL)) return VTK2_ERR_PLATFORM;
+	if (!eglBindAPI(EGL_OPENGL_API)) return VTK2_ERR_PLATFORM;
+
+	EGLConfig cfg;
+	EGLint ncfg;
+	EGLint cfg_attrs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+	if (!eglChooseConfig(dpy, cfg_attrs, &cfg, 1, &ncfg) || ncfg < 1) return VTK2_ERR_PLATFORM;
+
+	EGLint ctx_attrs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE,
+	};
+	EGLContext ctx = eglCreateContext(dpy, cfg, EGL_NO_CONTEXT, ctx_attrs);
+	if (ctx == EGL_NO_CONTEXT) return VTK2_ERR_PLATFORM;
+	if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+		eglDestroyContext(dpy, ctx);
+		return VTK2_ERR_PLATFORM;
+	}
+
+	win->win = NULL;
+	win->egl_display = dpy;
+	win->egl_context = ctx;
+
+	enum vtk2_err err = _vtk2_window_setup(win);
+	if (err) {
+		eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(dpy, ctx);
+		return err;
+	}
+
+	win->fb_w = win->win_w = w;
+	win->fb_h = win->win_h = h;
+
+	// There is no default framebuffer, so the back buffer is all we have
+	win->fb = nvgluCreateFramebuffer(win->vg, w, h, 0);
+	if (!win->fb) {
+		_vtk2_window_unsetup(win);
+		eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(dpy, ctx);
+		return VTK2_ERR_PLATFORM;
+	}
+
+	return 0;
+}
+#endif
+
+static void _vtk2_window_make_current(struct vtk2_win *win) {
+#ifdef VTK2_HEADLESS
+	if (!win->win) {
+		if (eglGetCurrentContext() != win->egl_context) {
+			eglMakeCurrent(win->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, win->egl_context);
+		}
+		return;
+	}
+#endif
+	if (glfwGetCurrentContext() != win->win) {
+		glfwMakeContextCurrent(win->win);
+	}
+}
+
+void vtk2_block_release(struct vtk2_block *block) {
+	if (!block) return;
+	if (block->type && block->type->release) block->type->release(block);
+}
+
+static void _vtk2_block_deinit(struct vtk2_block *block) {
+	if (!block) return;
+	if (block->type && block->type->deinit) block->type->deinit(block);
+	_vtk2_draw_list_free(block->retained);
+	block->retained = NULL;
+}
+
+void vtk2_window_deinit(struct vtk2_win *win) {
+	_vtk2_window_stop_layout(win);
+	vtk2_window_parallel_layout(win, 0);
+	_vtk2_window_drop_commits(win);
+	_vtk2_window_drop_updates(win);
+	_vtk2_block_deinit(win->root);
+	vtk2_block_release(win->root);
+	_vtk2_window_make_current(win);
+	if (win->fb) nvgluDeleteFramebuffer(win->fb);
+	for (size_t i = 0; i < win->text_cache_cap; i++) {
+		free(win->text_cache[i].str);
+	}
+	free(win->text_cache);
+	free(win->polls);
+	free(win->input);
+	_vtk2_window_unsetup(win);
+
+#ifdef VTK2_HEADLESS
+	if (!win->win) {
+		eglMakeCurrent(win->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(win->egl_display, win->egl_context);
+		return;
+	}
+#endif
+	glfwDestroyWindow(win->win);
+}
+
+enum vtk2_err vtk2_window_read_pixels(struct vtk2_win *win, uint8_t *pixels) {
+	if (!win->fb) return VTK2_ERR_PLATFORM;
+	_vtk2_window_make_current(win);
+
+	nvgluBindFramebuffer(win->fb);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, win->fb_w, win->fb_h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	nvgluBindFramebuffer(NULL);
+
+	// GL rows go bottom to top
+	size_t stride = 4 * (size_t)win->fb_w;
+	for (uint32_t y = 0; y < win->fb_h / 2; y++) {
+		uint8_t *a = pixels + y * stride, *b = pixels + (win->fb_h - 1 - y) * stride;
+		for (size_t i = 0; i < stride; i++) {
+			uint8_t t = a[i];
+			a[i] = b[i];
+			b[i] = t;
+		}
+	}
+
+	return 0;
+}
+
+enum vtk2_err vtk2_window_set_root(struct vtk2_win *win, struct vtk2_block *root) {
+	vtk2_window_lock(win);
+	_vtk2_window_drop_commits(win);
+	_vtk2_window_drop_updates(win);
+	_vtk2_block_deinit(win->root);
+	_vtk2_window_forget_hover(win);
+
+	// Initialize root block
+	root->parent = NULL;
+	enum vtk2_err err = vtk2_block_init(win, root);
+	if (err == 0) {
+		win->root = root;
+	}
+	atomic_store(&win->damage_all, 1);
+
+	vtk2_window_unlock(win);
+	return err;
+}
+
+//// Main loop ////
+// Start a frame, holding off the next one if anything was drawn
+static void _vtk2_window_frame(struct vtk2_win *win, double now) {
+	// Updates requested from here on need a new wakeup
+	atomic_store(&win->wake_posted, 0);
+
+	double deadline = now + win->frame_interval;
+	atomic_store(&win->frame_deadline, deadline);
+	if (win->frame_fn) win->frame_fn(win, deadline, win->frame_data);
+
+	if (vtk2_window_draw(win)) win->frame_next = deadline;
+}
+
+void vtk2_window_mainloop(struct vtk2_win *win) {
+	win->frame_next = glfwGetTime();
+	while (!glfwWindowShouldClose(win->win)) {
+		double now = glfwGetTime();
+		if (now < win->frame_next) {
+			// Too soon for another frame; keep handling events until it's due
+			glfwWaitEventsTimeout(win->frame_next - now);
+			continue;
+		}
+
+		_vtk2_window_frame(win, now);
+		glfwWaitEvents();
+	}
+}
+
+//// Apps ////
+void vtk2_app_init(struct vtk2_app *app) {
+	atomic_init(&app->queued, NULL);
+	app->pending = NULL;
+	app->nwindows = 0;
+}
+
+// Tell the window's app that it wants a frame. May be called concurrently
+static void _vtk2_app_queue(struct vtk2_win *win) {
+	struct vtk2_app *app = win->app;
+	if (!app || atomic_exchange(&win->app_queued, 1)) return;
+
+	// Push onto the queued stack; the main loop takes the whole stack at once, so there is no ABA problem
+	struct vtk2_win *head = atomic_load(&app->queued);
+	do win->app_next = head;
+	while (!atomic_compare_exchange_weak(&app->queued, &head, win));
+}
+
+enum vtk2_err vtk2_app_add(struct vtk2_app *app, struct vtk2_win *win) {
+	if (!win->win) return VTK2_ERR_PLATFORM;
+
+	// Waiting for vertical blank in every window would cap the whole app at refresh rate / windows
+	_vtk2_window_make_current(win);
+	glfwSwapInterval(0);
+
+	win->app = app;
+	win->frame_next = glfwGetTime();
+	app->nwindows++;
+	_vtk2_app_queue(win);
+	return 0;
+}
+
+void vtk2_app_run(struct vtk2_app *app) {
+	while (app->nwindows) {
+		// Take every window updated since the last iteration
+		struct vtk2_win *win = atomic_exchange(&app->queued, NULL);
+		while (win) {
+			struct vtk2_win *next = win->app_next;
+			win->app_next = app->pending;
+			app->pending = win;
+			win = next;
+		}
+
+		// Draw the windows whose frames are due, and work out how long until the rest are
+		double now = glfwGetTime(), wait = INFINITY;
+		struct vtk2_win **link = &app->pending;
+		while ((win = *link)) {
+			if (glfwWindowShouldClose(win->win)) {
+				*link = win->app_next;
+				glfwHideWindow(win->win);
+				win->app = NULL;
+				atomic_store(&win->app_queued, 0);
+				app->nwindows--;
+				continue;
+			}
+
+			if (now < win->frame_next) {
+				if (win->frame_next - now < wait) wait = win->frame_next - now;
+				link = &win->app_next;
+				continue;
+			}
+
+			// Updates from here on queue the window again
+			*link = win->app_next;
+			atomic_store(&win->app_queued, 0);
+			_vtk2_window_frame(win, now);
+		}
+
+		if (!app->nwindows) break;
+		if (wait < INFINITY) glfwWaitEventsTimeout(wait);
+		else glfwWaitEvents();
+	}
+}
+
+void vtk2_window_redraw(struct vtk2_win *win) {
+	atomic_store(&win->damage_all, 1);
+	vtk2_window_update(win);
+}
+
+void vtk2_window_update(struct vtk2_win *win) {
+	atomic_flag_clear_explicit(&win->clean, memory_order_release);
+	_vtk2_app_queue(win);
+
+	// One wakeup is enough however many updates arrive before the next frame
+	if (win->win && !atomic_exchange(&win->wake_posted, 1)) glfwPostEmptyEvent();
+}
+
+void vtk2_window_set_max_fps(struct vtk2_win *win, double fps) {
+	if (fps > 0) {
+		win->frame_interval = 1 / fps;
+		return;
+	}
+
+	// Headless windows have no display, and GLFW may not even be initialized
+	if (!win->win) {
+		win->frame_interval = 0;
+		return;
+	}
+
+	// Follow the refresh rate of the display, if we can find out what it is
+	GLFWmonitor *monitor = glfwGetWindowMonitor(win->win);
+	if (!monitor) monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+	win->frame_interval = mode && mode->refreshRate > 0 ? 1.0 / mode->refreshRate : 0;
+}
+
+void vtk2_window_on_frame(struct vtk2_win *win, void (*fn)(struct vtk2_win *win, double deadline, void *data), void *data) {
+	win->frame_fn = fn;
+	win->frame_data = data;
+}
+
+double vtk2_window_frame_deadline(struct vtk2_win *win) {
+	return atomic_load(&win->frame_deadline);
+}
+
+//// Arenas ////
+// Chunks hold many small allocations; anything larger gets a chunk to itself
+#define VTK2_ARENA_CHUNK_SIZE 16384
+
+struct vtk2_arena_chunk {
+	struct vtk2_arena_chunk *prev;
+	size_t used, cap;
+	_Alignas(max_align_t) unsigned char data[];
+};
+
+void vtk2_arena_init(struct vtk2_arena *arena) {
+	arena->chunk = NULL;
+}
+
+void vtk2_arena_deinit(struct vtk2_arena *arena) {
+	while (arena->chunk) {
+		struct vtk2_arena_chunk *prev = arena->chunk->prev;
+		free(arena->chunk);
+		arena->chunk = prev;
+	}
+}
+
+void *vtk2_arena_alloc(struct vtk2_arena *arena, size_t size) {
+	size_t align = _Alignof(max_align_t);
+	size = (size + align - 1) & ~(align - 1);
+
+	struct vtk2_arena_chunk *chunk = arena->chunk;
+	if (!chunk || chunk->cap - chunk->used < size) {
+		size_t cap = size > VTK2_ARENA_CHUNK_SIZE ? size : VTK2_ARENA_CHUNK_SIZE;
+		chunk = malloc(sizeof *chunk + cap);
+		if (!chunk) return NULL;
+		chunk->used = 0;
+		chunk->cap = cap;
+
+		if (arena->chunk && size > VTK2_ARENA_CHUNK_SIZE) {
+			// Keep filling the current chunk after this one
+			chunk->prev = arena->chunk->prev;
+			arena->chunk->prev = chunk;
+		} else {
+			chunk->prev = arena->chunk;
+			arena->chunk = chunk;
+		}
+	}
+
+	void *ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+//// Thread pool ////
+#define VTK2_PARALLEL_WEIGHT 32 // Number of blocks worth laying out on another thread
+#define VTK2_PARALLEL_BATCH 16 // Maximum tasks spawned at once by a single box
+
+static void _vtk2_box_arrange_range(struct vtk2_b_box *box, size_t start, size_t end, float rect[4], enum vtk2_shrink shrink);
+static void _vtk2_task_run(struct vtk2_task *task) {
+	_vtk2_box_arrange_range(task->box, task->start, task->end, task->rect, task->shrink);
+	atomic_store_explicit(&task->done, 1, memory_order_release);
+}
+
+static _Bool _vtk2_deque_push(struct vtk2_worker *w, struct vtk2_task *task) {
+	long long b = atomic_load_explicit(&w->bottom, memory_order_relaxed);
+	long long t = atomic_load_explicit(&w->top, memory_order_acquire);
+	if (b - t >= VTK2_DEQUE_SIZE) return 0;
+	atomic_store_explicit(&w->tasks[b & (VTK2_DEQUE_SIZE - 1)], task, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+	return 1;
+}
+
+static struct vtk2_task *_vtk2_deque_pop(struct vtk2_worker *w) {
+	long long b = atomic_load_explicit(&w->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&w->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long t = atomic_load_explicit(&w->top, memory_order_relaxed);
+
+	struct vtk2_task *task = NULL;
+	if (t <= b) {
+		task = atomic_load_explicit(&w->tasks[b & (VTK2_DEQUE_SIZE - 1)], memory_order_relaxed);
+		if (t == b) {
+			// Last task; race any thieves for it
+			if (!atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+				task = NULL;
+			}
+			atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+		}
+	} else {
+		atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+	}
+	return task;
+}
+
+static struct vtk2_task *_vtk2_deque_steal(struct vtk2_worker *w) {
+	long long t = atomic_load_explicit(&w->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long b = atomic_load_explicit(&w->bottom, memory_order_acquire);
+	if (t >= b) return NULL;
+
+	struct vtk2_task *task = atomic_load_explicit(&w->tasks[t & (VTK2_DEQUE_SIZE - 1)], memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+		return NULL;
+	}
+	return task;
+}
+
+// Find something to do, preferring our own most recent tasks
+static struct vtk2_task *_vtk2_worker_find(struct vtk2_worker *self) {
+	struct vtk2_task *task = _vtk2_deque_pop(self);
+	if (task) return task;
+
+	struct vtk2_pool *pool = self->pool;
+	for (size_t i = 0; i < pool->nworkers; i++) {
+		struct vtk2_worker *victim = &pool->workers[self->victim++ % pool->nworkers];
+		if (victim != self && (task = _vtk2_deque_steal(victim))) return task;
+	}
+	return NULL;
+}
+
+static void _vtk2_worker_spawn(struct vtk2_worker *self, struct vtk2_task *task) {
+	if (!_vtk2_deque_push(self, task)) {
+		// Plenty queued already
+		_vtk2_task_run(task);
+		return;
+	}
+
+	struct vtk2_pool *pool = self->pool;
+	atomic_fetch_add(&pool->spawned, 1);
+	if (atomic_load(&pool->sleeping)) {
+		mtx_lock(&pool->lock);
+		cnd_broadcast(&pool->cond);
+		mtx_unlock(&pool->lock);
+	}
+}
+
+// Help with other tasks until the specified one is finished
+static void _vtk2_worker_wait(struct vtk2_worker *self, struct vtk2_task *task) {
+	while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+		struct vtk2_task *other = _vtk2_worker_find(self);
+		if (other) {
+			_vtk2_task_run(other);
+		} else {
+			thrd_yield();
+		}
+	}
+}
+
+static int _vtk2_pool_thread(void *arg) {
+	struct vtk2_worker *self = arg;
+	struct vtk2_pool *pool = self->pool;
+	_vtk2_worker = self;
+
+	mtx_lock(&pool->lock);
+	while (!pool->quit) {
+		if (!atomic_load(&pool->active)) {
+			cnd_wait(&pool->cond, &pool->lock);
+			continue;
+		}
+		size_t seen = atomic_load(&pool->spawned);
+		mtx_unlock(&pool->lock);
+
+		// Steal work until there's none left
+		struct vtk2_task *task;
+		while ((task = _vtk2_worker_find(self))) {
+			_vtk2_task_run(task);
+		}
+
+		// Sleep until more tasks are spawned, rather than spinning for the rest of the layout
+		// Spawners check for sleepers after counting their task, so one of us always sees the other
+		mtx_lock(&pool->lock);
+		atomic_fetch_add(&pool->sleeping, 1);
+		if (!pool->quit && atomic_load(&pool->active) && atomic_load(&pool->spawned) == seen) {
+			cnd_wait(&pool->cond, &pool->lock);
+		}
+		atomic_fetch_sub(&pool->sleeping, 1);
+	}
+	mtx_unlock(&pool->lock);
+	return 0;
+}
+
+static void _vtk2_pool_destroy(struct vtk2_pool *pool, size_t nthreads) {
+	if (!pool) return;
+	mtx_lock(&pool->lock);
+	pool->quit = 1;
+	cnd_broadcast(&pool->cond);
+	mtx_unlock(&pool->lock);
+	for (size_t i = 0; i < nthreads; i++) {
+		thrd_join(pool->threads[i], NULL);
+	}
+	cnd_destroy(&pool->cond);
+	mtx_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
+
+enum vtk2_err vtk2_window_parallel_layout(struct vtk2_win *win, size_t nthreads) {
+	vtk2_window_lock(win);
+	struct vtk2_pool *old = win->pool;
+	win->pool = NULL;
+	if (old) _vtk2_pool_destroy(old, old->nworkers - 1);
+	vtk2_window_unlock(win);
+	if (nthreads <= 1) return 0;
+
+	struct vtk2_pool *pool = calloc(1, sizeof *pool + nthreads * sizeof *pool->workers);
+	if (!pool) return VTK2_ERR_ALLOC;
+	pool->threads = calloc(nthreads - 1, sizeof *pool->threads);
+	if (!pool->threads) {
+		free(pool);
+		return VTK2_ERR_ALLOC;
+	}
+	if (mtx_init(&pool->lock, mtx_plain) != thrd_success) {
+		free(pool->threads);
+		free(pool);
+		return VTK2_ERR_PLATFORM;
+	}
+	if (cnd_init(&pool->cond) != thrd_success) {
+		mtx_destroy(&pool->lock);
+		free(pool->threads);
+		free(pool);
+		return VTK2_ERR_PLATFORM;
+	}
+	pool->nworkers = nthreads;
+	for (size_t i = 0; i < nthreads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].victim = i + 1;
+	}
+
+	for (size_t i = 1; i < nthreads; i++) {
+		if (thrd_create(&pool->threads[i - 1], _vtk2_pool_thread, &pool->workers[i]) != thrd_success) {
+			_vtk2_pool_destroy(pool, i - 1);
+			return VTK2_ERR_PLATFORM;
+		}
+	}
+
+	vtk2_window_lock(win);
+	win->pool = pool;
+	vtk2_window_unlock(win);
+	return 0;
+}
+
+// Hand the results gathered by a worker over to the window
+static void _vtk2_worker_collect(struct vtk2_win *win, struct vtk2_worker *w) {
+	if (w->commits) {
+		struct vtk2_block *last = w->commits;
+		while (last->commit_next) last = last->commit_next;
+		last->commit_next = win->commits;
+		win->commits = w->commits;
+		w->commits = NULL;
+	}
+#ifdef VTK2_PROFILE
+	_vtk2_prof_add(&win->layout_stats, &w->stats);
+#endif
+}
+
+//// Layout kernels ////
+// Boxes keep their children's layout inputs in packed arrays, so these run over contiguous floats
+// rather than chasing a pointer to each child
+
+// Sum of a[0..n)
+static float _vtk2_sum(const float *a, size_t n) {
+	size_t i = 0;
+	float sum = 0;
+#if defined(VTK2_SSE)
+	__m128 acc = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) acc = _mm_add_ps(acc, _mm_loadu_ps(a + i));
+	acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+	sum = _mm_cvtss_f32(acc);
+#elif defined(VTK2_NEON)
+	float32x4_t acc = vdupq_n_f32(0);
+	for (; i + 4 <= n; i += 4) acc = vaddq_f32(acc, vld1q_f32(a + i));
+	sum = vaddvq_f32(acc);
+#endif
+	for (; i < n; i++) sum += a[i];
+	return sum;
+}
+
+// Maximum of a[0..n), or 0 if that is larger
+static float _vtk2_max(const float *a, size_t n) {
+	size_t i = 0;
+	float max = 0;
+#if defined(VTK2_SSE)
+	__m128 acc = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) acc = _mm_max_ps(acc, _mm_loadu_ps(a + i));
+	acc = _mm_max_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_max_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+	max = _mm_cvtss_f32(acc);
+#elif defined(VTK2_NEON)
+	float32x4_t acc = vdupq_n_f32(0);
+	for (; i + 4 <= n; i += 4) acc = vmaxq_f32(acc, vld1q_f32(a + i));
+	max = vmaxvq_f32(acc);
+#endif
+	for (; i < n; i++) max = fmaxf(max, a[i]);
+	return max;
+}
+
+// out[i] = a[i] + k * b[i]
+static void _vtk2_axpy(float *out, const float *a, float k, const float *b, size_t n) {
+	size_t i = 0;
+#if defined(VTK2_SSE)
+	__m128 kv = _mm_set1_ps(k);
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_mul_ps(kv, _mm_loadu_ps(b + i))));
+	}
+#elif defined(VTK2_NEON)
+	float32x4_t kv = vdupq_n_f32(k);
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(out + i, vaddq_f32(vld1q_f32(a + i), vmulq_f32(kv, vld1q_f32(b + i))));
+	}
+#endif
+	for (; i < n; i++) out[i] = a[i] + k * b[i];
+}
+
+//// Block functions ////
+// Type of blocks that don't set one, which fill their space and do nothing else
+static const struct vtk2_block_type _vtk2_plain_type = {0};
+
+enum vtk2_err vtk2_block_init(struct vtk2_win *win, struct vtk2_block *block) {
+	if (!block->type) block->type = &_vtk2_plain_type;
+	block->win = win;
+	atomic_init(&block->dirty, 1);
+	atomic_init(&block->damaged, 0);
+	block->layout_rect[0] = NAN; // Never matches, so the first arrange always runs
+	memset(block->draw_rect, 0, sizeof block->draw_rect);
+	block->queued = block->redraw = 0;
+	block->commit_next = NULL;
+
+	enum vtk2_err err = 0;
+	if (block->type->init) {
+		err = block->type->init(block);
+	}
+	return err;
+}
+
+static inline float _vtk2_forf(float a, float b) {
+	return isnan(a) ? b : a;
+}
+// Apply the block's size constraints to the provided dimensions
+static void _vtk2_block_clamp(struct vtk2_block *block, float dims[2]) {
+	float w = dims[0], h = dims[1];
+
+	if (block->grow == 0) {
+		w = _vtk2_forf(block->size[0], w);
+		h = _vtk2_forf(block->size[1], h);
+	} else {
+		w = fmaxf(block->size[0], w);
+		h = fmaxf(block->size[1], h);
+	}
+
+	dims[0] = fmaxf(0, w);
+	dims[1] = fmaxf(0, h);
+}
+static void _vtk2_block_constrain(struct vtk2_block *block) {
+	_vtk2_block_clamp(block, &block->rect[2]);
+}
+
+void vtk2_block_measure(struct vtk2_block *block) {
+	if (!block) return;
+
+	// Reuse the cached size if nothing has changed
+	// The flag is cleared before measuring so that concurrent invalidations are picked up next frame
+	if (!atomic_exchange(&block->dirty, 0)) return;
+	block->measured = 1;
+	block->weight = 1;
+	block->serial = 0;
+	VTK2_PROF_COUNT(block->win, measure_calls);
+
+	if (block->type->measure) {
+		block->type->measure(block);
+	} else if (block->type->layout) {
+		// Compatibility shim for blocks that only know how to lay themselves out
+		block->rect[0] = block->rect[1] = 0;
+		block->rect[2] = block->rect[3] = INFINITY;
+		block->type->layout(block, VTK2_SHRINK_NONE);
+		block->pref[0] = block->rect[2];
+		block->pref[1] = block->rect[3];
+	} else {
+		// Default blocks fill all available space, unless they have a size set
+		block->pref[0] = block->pref[1] = INFINITY;
+		_vtk2_block_clamp(block, block->pref);
+	}
+}
+
+void vtk2_block_arrange(struct vtk2_block *block, float rect[4], enum vtk2_shrink shrink) {
+	if (!block) return;
+
+	// Skip the whole subtree if it has the same constraints as last time
+	if (!block->measured && shrink == block->layout_shrink && !memcmp(rect, block->layout_rect, sizeof block->layout_rect)) {
+		return;
+	}
+	block->measured = 0;
+	VTK2_PROF_COUNT(block->win, arrange_calls);
+	block->layout_shrink = shrink;
+	memcpy(block->layout_rect, rect, sizeof block->layout_rect);
+
+	float old_rect[4];
+	memcpy(old_rect, block->rect, sizeof old_rect);
+
+	// Compute margins
+	float mx = block->margins[0];
+	float my = block->margins[1];
+	float mw = block->margins[2] + mx;
+	float mh = block->margins[3] + my;
+
+	// Set initial rect size
+	block->rect[0] = rect[0] + mx;
+	block->rect[1] = rect[1] + my;
+	block->rect[2] = fmaxf(0, rect[2] - mw);
+	block->rect[3] = fmaxf(0, rect[3] - mh);
+
+	// Compute layout
+	if (block->type->layout) {
+		block->type->layout(block, shrink);
+	} else {
+		// Default, very simple sizing algorithm
+		_vtk2_block_constrain(block);
+	}
+
+	// Queue the block to be shown if it moved or its contents changed
+	_Bool damaged = atomic_exchange(&block->damaged, 0);
+	if (damaged || block->type->commit || memcmp(old_rect, block->rect, sizeof old_rect)) {
+		block->redraw |= damaged;
+		if (!block->queued) {
+			struct vtk2_block **commits = _vtk2_worker ? &_vtk2_worker->commits : &block->win->commits;
+			block->queued = 1;
+			block->commit_next = *commits;
+			*commits = block;
+		}
+	}
+}
+
+void vtk2_block_layout(struct vtk2_block *block, float rect[4], enum vtk2_shrink shrink) {
+	if (_vtk2_worker || !block || !block->win) {
+		// Part of a larger layout, eg. a list laying out its rows
+		vtk2_block_measure(block);
+		vtk2_block_arrange(block, rect, shrink);
+		return;
+	}
+
+	struct vtk2_win *win = block->win;
+	struct vtk2_pool *pool = win->pool;
+	struct vtk2_worker local = {0};
+	_vtk2_worker = pool ? &pool->workers[0] : &local;
+
+	// Measuring is cheap compared to arranging, so is always done on this thread
+	vtk2_block_measure(block);
+	if (pool) {
+		mtx_lock(&pool->lock);
+		atomic_store(&pool->active, 1);
+		cnd_broadcast(&pool->cond);
+		mtx_unlock(&pool->lock);
+	}
+	vtk2_block_arrange(block, rect, shrink);
+	if (pool) atomic_store(&pool->active, 0);
+	_vtk2_worker = NULL;
+
+	// Every task has finished by now, so the other workers are done with their results
+	if (pool) {
+		for (size_t i = 0; i < pool->nworkers; i++) {
+			_vtk2_worker_collect(win, &pool->workers[i]);
+		}
+	} else {
+		_vtk2_worker_collect(win, &local);
+	}
+}
+
+// Mark a block as needing layout and redraw, without scheduling a frame
+// Returns false if the change is picked up by the layout in progress, so needs no new frame
+static _Bool _vtk2_block_mark(struct vtk2_block *block) {
+	atomic_store(&block->damaged, 1);
+	for (; block; block = block->parent) {
+		// Rows being bound are laid out straight afterwards, and their list has already been measured
+		if (block == _vtk2_binding) return 0;
+		// If this block is already dirty, its ancestors must be too
+		if (atomic_exchange(&block->dirty, 1)) break;
+	}
+	if (!_vtk2_binding) return 1;
+
+	// Stopped early, so check whether the block is in the list being bound, or somewhere else entirely
+	for (; block; block = block->parent) {
+		if (block == _vtk2_binding) return 0;
+	}
+	return 1;
+}
+
+void vtk2_block_invalidate(struct vtk2_block *block) {
+	if (!block) return;
+	if (_vtk2_block_mark(block) && block->win) vtk2_window_update(block->win);
+}
+
+// Layout function for leaf blocks that always take their preferred size
+static void _vtk2_block_fit(struct vtk2_block *block, enum vtk2_shrink shrink) {
+	block->rect[2] = block->pref[0];
+	block->rect[3] = block->pref[1];
+}
+
+//// Box block ////
+// Allocate the packed child arrays with room for cap children. Their contents are filled in by measure
+static enum vtk2_err _vtk2_box_alloc_packed(struct vtk2_b_box *box, size_t cap) {
+	float *packed = malloc(4 * cap * sizeof *packed);
+	if (!packed) return VTK2_ERR_ALLOC;
+	free(box->child_basis);
+	box->child_basis = packed;
+	box->child_cross = box->child_basis + cap;
+	box->child_grow = box->child_cross + cap;
+	box->child_slot = box->child_grow + cap;
+	return 0;
+}
+
+static enum vtk2_err _vtk2_box_init(struct vtk2_block *base) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+
+	// Leave room for every child the list has space for, so inserting doesn't need to reallocate
+	size_t cap = box->children_cap ? box->children_cap : box->nchildren;
+	if (cap) {
+		enum vtk2_err err = _vtk2_box_alloc_packed(box, cap);
+		if (err) return err;
+	}
+
+	if (box->layer) {
+		box->layer_valid = 0;
+		box->layer_next = box->base.win->layers;
+		box->base.win->layers = box;
+	}
+
+	for (size_t i = 0; i < box->nchildren; i++) {
+		box->children[i]->parent = &box->base;
+		enum vtk2_err err = vtk2_block_init(box->base.win, box->children[i]);
+		if (err) return err;
+	}
+	return 0;
+}
+
+static void _vtk2_box_deinit(struct vtk2_block *base) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	for (size_t i = 0; i < box->nchildren; i++) {
+		_vtk2_block_deinit(box->children[i]);
+	}
+	// The child list stays, so the box can be initialized again or inserted elsewhere with the same children
+	free(box->child_basis);
+	box->child_basis = NULL;
+
+	if (box->layer) {
+		struct vtk2_win *win = box->base.win;
+		for (struct vtk2_b_box **p = &win->layers; *p; p = &(*p)->layer_next) {
+			if (*p == box) {
+				*p = box->layer_next;
+				break;
+			}
+		}
+		if (box->layer_fb) {
+			_vtk2_window_make_current(win);
+			nvgluDeleteFramebuffer(box->layer_fb);
+			box->layer_fb = NULL;
+		}
+	}
+}
+
+static inline float _vtk2_block_dimsize(struct vtk2_block *block, int dim) {
+	return block->rect[2 + dim] + block->margins[dim] + block->margins[2 + dim];
+}
+// Size a block asks for along the specified axis, including margins
+// Blocks that fill their parent ask only for their minimum size, and rely on their grow factor to get more
+static inline float _vtk2_block_basis(struct vtk2_block *block, int dim) {
+	float pref = isinf(block->pref[dim]) ? fmaxf(0, _vtk2_forf(block->size[dim], 0)) : block->pref[dim];
+	return pref + block->margins[dim] + block->margins[2 + dim];
+}
+static void _vtk2_box_measure(struct vtk2_block *base) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+
+	int dim = box->direction;
+	for (size_t i = 0; i < box->nchildren; i++) {
+		struct vtk2_block *child = box->children[i];
+		vtk2_block_measure(child);
+		box->base.weight += child->weight;
+		box->base.serial |= child->serial;
+		box->child_basis[i] = _vtk2_block_basis(child, dim);
+		box->child_cross[i] = child->pref[1 - dim] + child->margins[1 - dim] + child->margins[3 - dim];
+		box->child_grow[i] = child->grow;
+	}
+
+	// Layout needs these too, and they only change when a child is measured again
+	box->basis_total = _vtk2_sum(box->child_basis, box->nchildren);
+	box->grow_total = _vtk2_sum(box->child_grow, box->nchildren);
+
+	box->base.pref[dim] = box->basis_total;
+	box->base.pref[1 - dim] = _vtk2_max(box->child_cross, box->nchildren);
+	_vtk2_block_clamp(&box->base, box->base.pref);
+}
+
+static void _vtk2_box_arrange_range(struct vtk2_b_box *box, size_t start, size_t end, float rect[4], enum vtk2_shrink shrink) {
+	int dim = box->direction;
+	for (size_t i = start; i < end; i++) {
+		struct vtk2_block *child = box->children[i];
+		rect[2 + dim] = box->child_slot[i];
+		vtk2_block_arrange(child, rect, shrink);
+		rect[dim] += _vtk2_block_dimsize(child, dim);
+	}
+}
+
+// Space a child takes up along the box's axis if it fills its slot, mirroring vtk2_block_arrange
+static inline float _vtk2_box_guess(struct vtk2_b_box *box, size_t i) {
+	int dim = box->direction;
+	struct vtk2_block *child = box->children[i];
+	float margins = child->margins[dim] + child->margins[2 + dim];
+	return fmaxf(0, box->child_slot[i] - margins) + margins;
+}
+
+// Arrange children on the thread pool
+// Where each chunk starts depends on the sizes of the children before it, so this guesses that every child
+// fills its slot, then arranges everything again in order; children that were placed correctly hit the arrange
+// cache, so the result is the same as arranging serially, and nearly as cheap when the guesses are right
+// Serial children are left out of the chunks, and only arranged by the final pass on this thread
+static void _vtk2_box_arrange_parallel(struct vtk2_b_box *box, struct vtk2_worker *worker, float rect[4], enum vtk2_shrink shrink) {
+	int dim = box->direction;
+	struct vtk2_task tasks[VTK2_PARALLEL_BATCH];
+
+	for (size_t start = 0; start < box->nchildren;) {
+		float guess = rect[dim];
+		size_t end = start, ntasks = 0;
+		while (end < box->nchildren && ntasks < VTK2_PARALLEL_BATCH) {
+			if (box->children[end]->serial) {
+				guess += _vtk2_box_guess(box, end++);
+				continue;
+			}
+
+			struct vtk2_task *task = &tasks[ntasks++];
+			task->box = box;
+			task->start = end;
+			memcpy(task->rect, rect, sizeof task->rect);
+			task->rect[dim] = guess;
+			task->shrink = shrink;
+			atomic_init(&task->done, 0);
+
+			// Split children into chunks big enough to be worth running elsewhere
+			size_t weight = 0;
+			for (; end < box->nchildren && weight < VTK2_PARALLEL_WEIGHT && !box->children[end]->serial; end++) {
+				weight += box->children[end]->weight;
+				guess += _vtk2_box_guess(box, end);
+			}
+			task->end = end;
+			_vtk2_worker_spawn(worker, task);
+		}
+
+		for (size_t i = 0; i < ntasks; i++) {
+			_vtk2_worker_wait(worker, &tasks[i]);
+		}
+		_vtk2_box_arrange_range(box, start, end, rect, shrink);
+		start = end;
+	}
+}
+
+static void _vtk2_box_layout(struct vtk2_block *base, enum vtk2_shrink shrink) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+
+	int dim = box->direction;
+
+	if (shrink != VTK2_SHRINK_NONE) {
+		// Shrink to fit our children along the requested axis
+		int sdim = shrink - VTK2_SHRINK_X;
+		box->base.rect[2 + sdim] = fminf(box->base.rect[2 + sdim], box->base.pref[sdim]);
+	}
+	_vtk2_block_constrain(&box->base);
+
+	// Divide leftover space according to grow factors
+	float space = box->base.rect[2 + dim] - box->basis_total;
+	float unit = box->grow_total == 0 ? 0 : fmaxf(0, space) / box->grow_total;
+	_vtk2_axpy(box->child_slot, box->child_basis, unit, box->child_grow, box->nchildren);
+
+	float rect[4] = {UNPACK_4(box->base.rect)};
+	struct vtk2_worker *worker = _vtk2_worker;
+	if (worker && worker->pool && box->base.weight >= 2 * VTK2_PARALLEL_WEIGHT) {
+		_vtk2_box_arrange_parallel(box, worker, rect, shrink);
+	} else {
+		_vtk2_box_arrange_range(box, 0, box->nchildren, rect, shrink);
+	}
+
+	// Children that were forced past their slots may overlap, which breaks the hit testing search
+	float end = -INFINITY;
+	box->layout_indexed = 1;
+	for (size_t i = 0; i < box->nchildren; i++) {
+		struct vtk2_block *child = box->children[i];
+		if (child->rect[dim] < end) box->layout_indexed = 0;
+		end = child->rect[dim] + child->rect[2 + dim];
+	}
+}
+
+static void _vtk2_box_commit(struct vtk2_block *base) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	if (box->indexed != box->layout_indexed) _vtk2_window_forget_hover(box->base.win);
+	box->indexed = box->layout_indexed;
+}
+
+#ifdef VTK2_BOX_DEBUG
+// SplitMix64
+static uint64_t splitmix64(uint64_t x) {
+	x += 0x9e3779b97f4a7c15;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+#endif
+
+// Region of the window covered by a layer, rounded out to whole pixels so the layer is composited without filtering
+static void _vtk2_box_layer_rect(struct vtk2_b_box *box, int px[4]) {
+	struct vtk2_win *win = box->base.win;
+	float *r = box->base.draw_rect;
+	float px_x = win->fb_w / win->win_w, px_y = win->fb_h / win->win_h;
+	px[0] = floorf(r[0] * px_x);
+	px[1] = floorf(r[1] * px_y);
+	px[2] = ceilf((r[0] + r[2]) * px_x) - px[0];
+	px[3] = ceilf((r[1] + r[3]) * px_y) - px[1];
+}
+
+static void _vtk2_box_draw_children(struct vtk2_b_box *box) {
+	struct vtk2_win *win = box->base.win;
+	for (size_t i = 0; i < box->nchildren; i++) {
+		// Skip children outside the region being redrawn
+		struct vtk2_block *child = box->children[i];
+		if (child->type->draw && _vtk2_rect_intersects(child->draw_rect, win->clip)) {
+			_vtk2_block_draw(child);
+		}
+	}
+}
+
+// Draw the box's children into its layer. Must be called between frames, with vg_lock held
+static void _vtk2_box_render_layer(struct vtk2_b_box *box) {
+	struct vtk2_win *win = box->base.win;
+	int px[4];
+	_vtk2_box_layer_rect(box, px);
+	if (px[2] <= 0 || px[3] <= 0) return;
+
+	// (Re)create the framebuffer if needed
+	if (box->layer_fb) {
+		int w, h;
+		nvgImageSize(win->vg, box->layer_fb->image, &w, &h);
+		if (w != px[2] || h != px[3]) {
+			nvgluDeleteFramebuffer(box->layer_fb);
+			box->layer_fb = NULL;
+		}
+	}
+	if (!box->layer_fb) {
+		box->layer_fb = nvgluCreateFramebuffer(win->vg, px[2], px[3], NVG_IMAGE_PREMULTIPLIED);
+		if (!box->layer_fb) return;
+	}
+
+	// Offset the viewport rather than transforming, so children draw exactly as they would into the window
+	nvgluBindFramebuffer(box->layer_fb);
+	glViewport(-px[0], px[3] + px[1] - (int)win->fb_h, win->fb_w, win->fb_h);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	nvgBeginFrame(win->vg, win->win_w, win->win_h, win->win_w / (float)win->fb_w);
+	nvgScissor(win->vg, UNPACK_4(box->base.draw_rect));
+	memcpy(win->clip, box->base.draw_rect, sizeof win->clip);
+	_vtk2_box_draw_children(box);
+	nvgEndFrame(win->vg);
+	box->layer_valid = 1;
+}
+
+// Mark every layer containing the block as out of date
+static void _vtk2_block_invalidate_layers(struct vtk2_block *block) {
+	if (!block->win->layers) return;
+	for (; block; block = block->parent) {
+		if (block->type != &_vtk2_box_type) continue;
+		struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, block);
+		if (box->layer) box->layer_valid = 0;
+	}
+}
+
+static void _vtk2_box_draw(struct vtk2_block *base) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+
+	struct vtk2_win *win = box->base.win;
+
+	if (box->layer && box->layer_valid && box->layer_fb) {
+		int px[4];
+		_vtk2_box_layer_rect(box, px);
+		float px_x = win->fb_w / win->win_w, px_y = win->fb_h / win->win_h;
+		float r[4] = {px[0] / px_x, px[1] / px_y, px[2] / px_x, px[3] / px_y};
+		nvgBeginPath(win->vg);
+		nvgRect(win->vg, UNPACK_4(r));
+		nvgFillPaint(win->vg, nvgImagePattern(win->vg, UNPACK_4(r), 0, box->layer_fb->image, 1));
+		nvgFill(win->vg);
+		return;
+	}
+
+#ifdef VTK2_BOX_DEBUG
+	uint64_t color = splitmix64(splitmix64((uint64_t)&box->base));
+	uint8_t r = (color >> 0) & 0xff;
+	uint8_t g = (color >> 8) & 0xff;
+	uint8_t b = (color >> 16) & 0xff;
+	uint8_t a = 255;
+
+	nvgBeginPath(win->vg);
+	nvgRect(win->vg, UNPACK_4(box->base.draw_rect));
+	nvgFillColor(win->vg, nvgRGBA(r, g, b, a));
+	nvgFill(win->vg);
+	nvgStrokeColor(win->vg, nvgRGBA(255, 255, 255, 150));
+	nvgStrokeWidth(win->vg, 1);
+	nvgStroke(win->vg);
+#endif
+
+	_vtk2_box_draw_children(box);
+}
+
+static struct vtk2_block *_vtk2_box_child(struct vtk2_b_box *box, float x, float y) {
+	size_t lo = 0, hi = box->nchildren;
+	if (box->indexed) {
+		// Children are in order along the main axis and don't overlap,
+		// so only the last one starting before the point can contain it
+		int dim = box->direction;
+		float pos = dim ? y : x;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (box->children[mid]->draw_rect[dim] <= pos) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		if (lo == 0) return NULL;
+		hi = lo--;
+	}
+
+	for (size_t i = lo; i < hi; i++) {
+		struct vtk2_block *child = box->children[i];
+		float x0 = child->draw_rect[0];
+		float y0 = child->draw_rect[1];
+		float x1 = x0 + child->draw_rect[2];
+		float y1 = y0 + child->draw_rect[3];
+
+		if (x0 <= x && x < x1 && y0 <= y && y < y1) {
+			return child;
+		}
+	}
+
+	return NULL;
+}
+
+static _Bool _vtk2_box_ev_button(struct vtk2_block *base, int button, int action, int mods) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	struct vtk2_block *child = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+	if (child && child->type->ev_button) {
+		return child->type->ev_button(child, button, action, mods);
+	}
+	return false;
+}
+
+static _Bool _vtk2_box_ev_enter(struct vtk2_block *base, _Bool entered) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	struct vtk2_block *child = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+	if (child && child->type->ev_enter) {
+		return child->type->ev_enter(child, entered);
+	}
+	return false;
+}
+
+static _Bool _vtk2_box_ev_key(struct vtk2_block *base, int key, int scancode, int action, int mods) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	if (!box->base.win->focused) {
+		box->base.win->focused = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+	}
+	struct vtk2_block *focused = box->base.win->focused;
+	if (focused && focused != base && focused->type->ev_key) {
+		return focused->type->ev_key(focused, key, scancode, action, mods);
+	}
+	return false;
+}
+
+static _Bool _vtk2_box_ev_mouse(struct vtk2_block *base, float new_x, float new_y, float old_x, float old_y) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	struct vtk2_block *child = _vtk2_box_child(box, new_x, new_y);
+	struct vtk2_block *old_child = _vtk2_box_child(box, old_x, old_y);
+	if (child != old_child && old_child && old_child->type->ev_enter) {
+		old_child->type->ev_enter(old_child, 0);
+	}
+	if (child && child->type->ev_mouse) {
+		return child->type->ev_mouse(child, new_x, new_y, old_x, old_y);
+	}
+	if (child != old_child && child && child->type->ev_enter) {
+		child->type->ev_enter(child, 1);
+	}
+	return false;
+}
+
+static _Bool _vtk2_box_ev_scroll(struct vtk2_block *base, float dx, float dy) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	struct vtk2_block *child = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+	if (child && child->type->ev_scroll) {
+		return child->type->ev_scroll(child, dx, dy);
+	}
+	return false;
+}
+
+static _Bool _vtk2_box_ev_text(struct vtk2_block *base, unsigned rune) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	if (!box->base.win->focused) {
+		box->base.win->focused = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+	}
+	struct vtk2_block *focused = box->base.win->focused;
+	if (focused && focused != base && focused->type->ev_text) {
+		return focused->type->ev_text(focused, rune);
+	}
+	return false;
+}
+
+// Make room for n children, taking ownership of the child list if the box doesn't have it yet
+static enum vtk2_err _vtk2_box_reserve(struct vtk2_b_box *box, size_t n) {
+	if (n <= box->children_cap) return 0;
+	size_t cap = box->children_cap ? 2 * box->children_cap : 8;
+	while (cap < n) cap *= 2;
+
+	// Keep the list null-terminated, for anything still walking it that way
+	struct vtk2_block **children = malloc((cap + 1) * sizeof *children);
+	if (!children) return VTK2_ERR_ALLOC;
+	if (box->base.win && _vtk2_box_alloc_packed(box, cap)) {
+		free(children);
+		return VTK2_ERR_ALLOC;
+	}
+	if (box->nchildren) memcpy(children, box->children, box->nchildren * sizeof *children);
+	children[box->nchildren] = NULL;
+
+	if (box->children_cap) free(box->children);
+	box->children = children;
+	box->children_cap = cap;
+	return 0;
+}
+
+static _Bool _vtk2_block_is_within(struct vtk2_block *block, struct vtk2_block *ancestor) {
+	for (; block; block = block->parent) {
+		if (block == ancestor) return 1;
+	}
+	return 0;
+}
+
+// Invalidate a box whose children have changed
+static void _vtk2_box_changed(struct vtk2_b_box *box) {
+	// Children aren't in position until the next commit, so hit testing can't rely on their order until then
+	box->indexed = 0;
+	if (box->base.win) _vtk2_window_forget_hover(box->base.win);
+	vtk2_block_invalidate(&box->base);
+}
+
+enum vtk2_err vtk2_box_insert(struct vtk2_block *block, size_t index, struct vtk2_block *child) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, block);
+	if (index > box->nchildren) index = box->nchildren;
+
+	enum vtk2_err err = _vtk2_box_reserve(box, box->nchildren + 1);
+	if (err) return err;
+
+	// Boxes that aren't in a window yet initialize their children along with themselves
+	child->parent = block;
+	if (block->win && (err = vtk2_block_init(block->win, child))) return err;
+
+	memmove(&box->children[index + 1], &box->children[index], (box->nchildren - index) * sizeof *box->children);
+	box->children[index] = child;
+	box->children[++box->nchildren] = NULL;
+	_vtk2_box_changed(box);
+	return 0;
+}
+
+struct vtk2_block *vtk2_box_remove(struct vtk2_block *block, size_t index) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, block);
+	if (index >= box->nchildren) return NULL;
+	if (_vtk2_box_reserve(box, box->nchildren)) return NULL;
+
+	struct vtk2_block *child = box->children[index];
+	struct vtk2_win *win = block->win;
+	if (win) {
+		// Nothing may refer to the child once it has gone
+		_vtk2_window_drop_subtree_commits(win, child);
+		_vtk2_window_drop_subtree_updates(win, child);
+		if (_vtk2_block_is_within(win->focused, child)) win->focused = NULL;
+		_vtk2_block_deinit(child);
+	}
+
+	memmove(&box->children[index], &box->children[index + 1], (box->nchildren - index - 1) * sizeof *box->children);
+	box->children[--box->nchildren] = NULL;
+	child->parent = NULL;
+
+	// Redrawing the box covers where the child used to be
+	_vtk2_box_changed(box);
+	return child;
+}
+
+enum vtk2_err vtk2_box_move(struct vtk2_block *block, size_t from, size_t to) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, block);
+	if (from >= box->nchildren) return 0;
+	if (to >= box->nchildren) to = box->nchildren - 1;
+	if (from == to) return 0;
+
+	enum vtk2_err err = _vtk2_box_reserve(box, box->nchildren);
+	if (err) return err;
+
+	struct vtk2_block *child = box->children[from];
+	if (from < to) {
+		memmove(&box->children[from], &box->children[from + 1], (to - from) * sizeof *box->children);
+	} else {
+		memmove(&box->children[to + 1], &box->children[to], (from - to) * sizeof *box->children);
+	}
+	box->children[to] = child;
+	_vtk2_box_changed(box);
+	return 0;
+}
+
+static void _vtk2_box_release(struct vtk2_block *base) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
+	for (size_t i = 0; i < box->nchildren; i++) {
+		vtk2_block_release(box->children[i]);
+	}
+	if (box->children_cap) free(box->children);
+	box->children = NULL;
+	box->nchildren = box->children_cap = 0;
+}
+
+size_t vtk2_box_count(struct vtk2_block *block) {
+	return fieldParentPtr(struct vtk2_b_box, base, block)->nchildren;
+}
+
+struct vtk2_block *vtk2_box_child(struct vtk2_block *block, size_t index) {
+	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, block);
+	return index < box->nchildren ? box->children[index] : NULL;
+}
+
+static const struct vtk2_block_type _vtk2_box_type = {
+	.init = _vtk2_box_init,
+	.deinit = _vtk2_box_deinit,
+	.release = _vtk2_box_release,
+	.draw = _vtk2_box_draw,
+	.measure = _vtk2_box_measure,
+	.layout = _vtk2_box_layout,
+	.commit = _vtk2_box_commit,
+	.ev_button = _vtk2_box_ev_button,
+	.ev_enter = _vtk2_box_ev_enter,
+	.ev_key = _vtk2_box_ev_key,
+	.ev_mouse = _vtk2_box_ev_mouse,
+	.ev_scroll = _vtk2_box_ev_scroll,
+	.ev_text = _vtk2_box_ev_text,
+};
+
+static void _vtk2_box_setup(struct vtk2_b_box *box, struct vtk2_box_settings settings) {
+	size_t n = 0;
+	while (settings.children && settings.children[n]) n++;
+
+	*box = (struct vtk2_b_box){
+		.children = settings.children,
+		.direction = settings.direction,
+		.nchildren = n,
+		.layer = settings.layer,
+		.base = (struct vtk2_block){
+			.grow = settings.grow,
+			.margins = {UNPACK_4(settings.margins)},
+			.size = {UNPACK_2(settings.size)},
+			.type = &_vtk2_box_type,
+		},
+	};
+}
+
+struct vtk2_block *_vtk2_make_box(struct vtk2_box_settings settings) {
+	struct vtk2_b_box *box = malloc(sizeof *box);
+	if (!box) abort();
+	_vtk2_box_setup(box, settings);
+	return &box->base;
+}
+
+enum vtk2_err _vtk2_new_box(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_box_settings settings) {
+	// Copy the child list into the arena too, so the caller's array can be temporary
+	if (settings.children) {
+		size_t n = 0;
+		while (settings.children[n]) n++;
+		struct vtk2_block **children = vtk2_arena_alloc(arena, (n + 1) * sizeof *children);
+		if (!children) return VTK2_ERR_ALLOC;
+		memcpy(children, settings.children, (n + 1) * sizeof *children);
+		settings.children = children;
+	}
+
+	struct vtk2_b_box *box = vtk2_arena_alloc(arena, sizeof *box);
+	if (!box) return VTK2_ERR_ALLOC;
+	_vtk2_box_setup(box, settings);
+	*out = &box->base;
+	return 0;
+}
+
+//// Hover tracking ////
+// Narrow bounds (x0, y0, x1, y1) to the part also inside block
+static void _vtk2_hover_clip(float bounds[4], const struct vtk2_block *block) {
+	const float *r = block->draw_rect;
+	bounds[0] = fmaxf(bounds[0], r[0]);
+	bounds[1] = fmaxf(bounds[1], r[1]);
+	bounds[2] = fminf(bounds[2], r[0] + r[2]);
+	bounds[3] = fminf(bounds[3], r[1] + r[3]);
+}
+
+// Follow the blocks under a point down from block, for as long as they are boxes that can route
+// the point to a child without looking at anything else, narrowing bounds to each block passed through
+static struct vtk2_block *_vtk2_hover_walk(struct vtk2_block *block, float x, float y, float bounds[4]) {
+	while (block->type == &_vtk2_box_type) {
+		struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, block);
+		// Overlapping children could route a point inside a child to an earlier sibling
+		if (!box->indexed) break;
+		struct vtk2_block *child = _vtk2_box_child(box, x, y);
+		if (!child) break;
+		block = child;
+		_vtk2_hover_clip(bounds, block);
+	}
+	return block;
+}
+
+// Deliver a cursor movement, starting from the deepest block on the hover path that is under both the old
+// and new positions, along with every block above it. Every box above that block would pass the event straight
+// down without any enter or leave events, so this is the same as delivering it to the root.
+// Children can stick out of their parents, so the path is only followed as far as all of it is under the cursor
+static void _vtk2_window_mouse(struct vtk2_win *win, float x, float y) {
+	struct vtk2_block *root = win->root;
+	if (!root) return;
+
+	struct vtk2_block *start = root;
+	float *b = win->hover_bounds;
+	if (win->hover && b[0] <= x && x < b[2] && b[1] <= y && y < b[3]) {
+		// Still inside the whole path, so nothing above the end of it can change
+		start = win->hover;
+	} else if (win->hover) {
+		for (struct vtk2_block *block = win->hover; block != root; block = block->parent) {
+			if (!_vtk2_rect_has_point(block->draw_rect, x, y)) start = block->parent;
+		}
+	}
+
+	size_t gen = win->hover_gen;
+	if (start->type->ev_mouse) {
+		start->type->ev_mouse(start, x, y, win->cx, win->cy);
+	}
+
+	// Only the part of the path below where it diverged needs finding again
+	// If the handler changed the tree, eg. by removing start or replacing the root, start may no longer be
+	// attached, so leave the path to be found from the root next time
+	if (win->hover_gen != gen) return;
+	if (start != win->hover || !win->hover) {
+		b[0] = b[1] = -INFINITY;
+		b[2] = b[3] = INFINITY;
+		for (struct vtk2_block *block = start; block != root; block = block->parent) {
+			_vtk2_hover_clip(b, block);
+		}
+	}
+	win->hover = _vtk2_hover_walk(start, x, y, b);
+}
+
+//// List block ////
+#define VTK2_LIST_SCROLL_ROWS 3 // Rows scrolled per mouse wheel step
+
+static enum vtk2_err _vtk2_list_init(struct vtk2_block *base) {
+	// Rows are created during layout, once the number needed is known
+	return 0;
+}
+
+static void _vtk2_list_deinit(struct vtk2_block *base) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	for (size_t i = 0; i < list->nslots; i++) {
+		struct vtk2_block *row = list->slots[i].row;
+		_vtk2_block_deinit(row);
+		vtk2_block_release(row);
+		if (list->row_free) list->row_free(row, list->data);
+	}
+	free(list->slots);
+	free(list->shown);
+	list->slots = list->shown = NULL;
+	list->nslots = list->nshown = 0;
+	list->first = list->last = 0;
+	list->shown_first = list->shown_last = 0;
+}
+
+// Grow the row pool to at least n rows, returning the number available
+static size_t _vtk2_list_reserve(struct vtk2_b_list *list, size_t n) {
+	if (n <= list->nslots || !list->row_new) return list->nslots;
+
+	struct vtk2_list_slot *slots = realloc(list->slots, n * sizeof *slots);
+	if (!slots) return list->nslots;
+	list->slots = slots;
+
+	// Rows may load fonts, which can't happen while the window is drawing
+	struct vtk2_win *win = list->base.win;
+	mtx_lock(&win->vg_lock);
+	for (; list->nslots < n; list->nslots++) {
+		struct vtk2_block *row = list->row_new(list->data);
+		if (!row) break;
+		row->parent = &list->base;
+		if (vtk2_block_init(win, row)) {
+			vtk2_block_release(row);
+			if (list->row_free) list->row_free(row, list->data);
+			break;
+		}
+		// Existing rows keep their items, since they may still be displayed
+		slots[list->nslots] = (struct vtk2_list_slot){row, SIZE_MAX};
+	}
+	mtx_unlock(&win->vg_lock);
+	return list->nslots;
+}
+
+// Check whether a row is displayed by the last committed layout, so must not be changed
+static _Bool _vtk2_list_showing(struct vtk2_b_list *list, size_t slot) {
+	if (!list->base.win->async || slot >= list->nshown) return 0;
+	size_t item = list->shown[slot].item;
+	return item >= list->shown_first && item < list->shown_last;
+}
+
+static void _vtk2_list_measure(struct vtk2_block *base) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	list->base.weight += list->nslots;
+	// row_bind is user code, documented to run on the thread drawing the window, so never run it speculatively
+	list->base.serial = 1;
+
+	// Lists fill whatever space they are given
+	base->pref[0] = base->pref[1] = INFINITY;
+	_vtk2_block_clamp(base, base->pref);
+}
+
+static void _vtk2_list_layout(struct vtk2_block *base, enum vtk2_shrink shrink) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	_vtk2_block_constrain(&list->base);
+
+	float h = list->base.rect[3];
+	double rh = list->row_height;
+	size_t count = atomic_load(&list->count);
+	_Bool rebind = atomic_exchange(&list->rebind, 0);
+	list->first = list->last = 0;
+	if (!(rh > 0) || !isfinite(h)) return;
+
+	// Keep the scroll position within the list, unless it has been changed again in the meantime
+	double scroll = atomic_load(&list->scroll);
+	list->offset = fmin(fmax(scroll, 0), fmax(0, count * rh - h));
+	if (list->offset != scroll) {
+		atomic_compare_exchange_strong(&list->scroll, &scroll, list->offset);
+	}
+
+	// Find the visible items, limited by the rows we can get
+	size_t first = list->offset / rh;
+	size_t last = ceil((list->offset + h) / rh);
+	if (last > count) last = count;
+	if (first > last) first = last;
+	// Reserve for the worst case alignment up front, so scrolling doesn't grow the pool a row at a time
+	size_t want = ceil(h / rh) + 1;
+	size_t nslots = _vtk2_list_reserve(list, want < count ? want : count);
+	if (last - first > nslots) last = first + nslots;
+	list->first = first;
+	list->last = last;
+
+	float rect[4] = {UNPACK_4(list->base.rect)};
+	rect[3] = rh;
+	for (size_t i = first; i < last; i++) {
+		struct vtk2_list_slot *slot = &list->slots[i % nslots];
+		if (slot->item != i || rebind) {
+			if (_vtk2_list_showing(list, i % nslots)) {
+				// Still on screen showing something else; hide it and bind it once it's gone
+				slot->item = SIZE_MAX;
+				list->pending = 1;
+				continue;
+			}
+
+			slot->item = i;
+			// Relayout and redraw the row, without dirtying the list we're in the middle of arranging
+			// row_bind usually invalidates the row itself, which must not reach the list either
+			_vtk2_binding = &list->base;
+			if (list->row_bind) list->row_bind(slot->row, i, list->data);
+			_vtk2_binding = NULL;
+			atomic_store(&slot->row->dirty, 1);
+			atomic_store(&slot->row->damaged, 1);
+		}
+
+		rect[1] = list->base.rect[1] + (i * rh - list->offset);
+		vtk2_block_layout(slot->row, rect, VTK2_SHRINK_NONE);
 	}
 }
 
-static struct vtk2_block *_vtk2_box_child(struct vtk2_b_box *box, float x, float y) {
-	for (struct vtk2_block **child = box->children; child && *child; child++) {
-		float x0 = (*child)->rect[0];
-		float y0 = (*child)->rect[1];
-		float x1 = x0 + (*child)->rect[2];
-		float y1 = y0 + (*child)->rect[3];
+static void _vtk2_list_commit(struct vtk2_block *base) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
 
-		if (x0 <= x && x < x1 && y0 <= y && y < y1) {
-			return *child;
+	if (list->nshown != list->nslots) {
+		struct vtk2_list_slot *shown = realloc(list->shown, list->nslots * sizeof *shown);
+		if (!shown) {
+			// Show nothing rather than rows we know nothing about, and try again next layout
+			list->shown_first = list->shown_last = 0;
+			vtk2_block_invalidate(&list->base);
+			return;
 		}
+		list->shown = shown;
+		list->nshown = list->nslots;
+	}
+	if (list->nshown) memcpy(list->shown, list->slots, list->nshown * sizeof *list->shown);
+	list->shown_first = list->first;
+	list->shown_last = list->last;
+	list->shown_offset = list->offset;
+
+	if (list->pending) {
+		list->pending = 0;
+		vtk2_block_invalidate(&list->base);
 	}
+}
 
-	return NULL;
+// Find the row displaying an item, if it is visible
+static struct vtk2_block *_vtk2_list_shown_row(struct vtk2_b_list *list, size_t i) {
+	if (i < list->shown_first || i >= list->shown_last) return NULL;
+	struct vtk2_list_slot *slot = &list->shown[i % list->nshown];
+	return slot->item == i ? slot->row : NULL;
 }
 
-static _Bool _vtk2_box_ev_button(struct vtk2_block *base, int button, int action, int mods) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
-	struct vtk2_block *child = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
-	if (child && child->ev_button) {
-		return child->ev_button(child, button, action, mods);
+static void _vtk2_list_draw(struct vtk2_block *base) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	struct vtk2_win *win = list->base.win;
+
+	// Rows at the edges are partly scrolled out of view
+	nvgSave(win->vg);
+	nvgIntersectScissor(win->vg, UNPACK_4(list->base.draw_rect));
+	for (size_t i = list->shown_first; i < list->shown_last; i++) {
+		struct vtk2_block *row = _vtk2_list_shown_row(list, i);
+		if (row && row->type->draw && _vtk2_rect_intersects(row->draw_rect, win->clip)) {
+			_vtk2_block_draw(row);
+		}
 	}
-	return false;
+	nvgRestore(win->vg);
 }
 
-static _Bool _vtk2_box_ev_enter(struct vtk2_block *base, _Bool entered) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
-	struct vtk2_block *child = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
-	if (child && child->ev_enter) {
-		return child->ev_enter(child, entered);
+static struct vtk2_block *_vtk2_list_row(struct vtk2_b_list *list, float x, float y) {
+	if (!_vtk2_rect_contains(list->base.draw_rect, (float[4]){x, y, 0, 0})) return NULL;
+
+	double i = floor((y - list->base.draw_rect[1] + list->shown_offset) / list->row_height);
+	if (!(i >= 0 && i < SIZE_MAX)) return NULL;
+	struct vtk2_block *row = _vtk2_list_shown_row(list, i);
+	if (!row) return NULL;
+
+	float x0 = row->draw_rect[0];
+	float y0 = row->draw_rect[1];
+	float x1 = x0 + row->draw_rect[2];
+	float y1 = y0 + row->draw_rect[3];
+	if (x0 <= x && x < x1 && y0 <= y && y < y1) {
+		return row;
 	}
-	return false;
+	return NULL;
 }
 
-static _Bool _vtk2_box_ev_key(struct vtk2_block *base, int key, int scancode, int action, int mods) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
-	if (!box->base.win->focused) {
-		box->base.win->focused = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+static void _vtk2_list_scroll_by(struct vtk2_b_list *list, double dy) {
+	double scroll = atomic_load(&list->scroll);
+	while (!atomic_compare_exchange_weak(&list->scroll, &scroll, scroll + dy));
+	vtk2_block_invalidate(&list->base);
+}
+
+static _Bool _vtk2_list_ev_button(struct vtk2_block *base, int button, int action, int mods) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE && list->dragging) {
+		list->dragging = 0;
+		return true;
 	}
-	struct vtk2_block *focused = box->base.win->focused;
-	if (focused && focused != base && focused->ev_key) {
-		return focused->ev_key(focused, key, scancode, action, mods);
+
+	struct vtk2_block *row = _vtk2_list_row(list, list->base.win->cx, list->base.win->cy);
+	if (row && row->type->ev_button && row->type->ev_button(row, button, action, mods)) {
+		return true;
+	}
+
+	// Rows that don't handle a press can be used to drag the list
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+		list->dragging = 1;
+		return true;
 	}
 	return false;
 }
 
-static _Bool _vtk2_box_ev_mouse(struct vtk2_block *base, float new_x, float new_y, float old_x, float old_y) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
-	struct vtk2_block *child = _vtk2_box_child(box, new_x, new_y);
-	struct vtk2_block *old_child = _vtk2_box_child(box, old_x, old_y);
-	if (child != old_child && old_child && old_child->ev_enter) {
-		old_child->ev_enter(old_child, 0);
-	}
-	if (child && child->ev_mouse) {
-		return child->ev_mouse(child, new_x, new_y, old_x, old_y);
-	}
-	if (child != old_child && child && child->ev_enter) {
-		child->ev_enter(child, 1);
+static _Bool _vtk2_list_ev_enter(struct vtk2_block *base, _Bool entered) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	if (!entered) list->dragging = 0;
+	struct vtk2_block *row = _vtk2_list_row(list, list->base.win->cx, list->base.win->cy);
+	if (row && row->type->ev_enter) {
+		return row->type->ev_enter(row, entered);
 	}
 	return false;
 }
 
-static _Bool _vtk2_box_ev_text(struct vtk2_block *base, unsigned rune) {
-	struct vtk2_b_box *box = fieldParentPtr(struct vtk2_b_box, base, base);
-	if (!box->base.win->focused) {
-		box->base.win->focused = _vtk2_box_child(box, box->base.win->cx, box->base.win->cy);
+static _Bool _vtk2_list_ev_mouse(struct vtk2_block *base, float new_x, float new_y, float old_x, float old_y) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	if (list->dragging) {
+		_vtk2_list_scroll_by(list, old_y - new_y);
+		return true;
 	}
-	struct vtk2_block *focused = box->base.win->focused;
-	if (focused && focused != base && focused->ev_text) {
-		return focused->ev_text(focused, rune);
+
+	struct vtk2_block *row = _vtk2_list_row(list, new_x, new_y);
+	struct vtk2_block *old_row = _vtk2_list_row(list, old_x, old_y);
+	if (row != old_row && old_row && old_row->type->ev_enter) {
+		old_row->type->ev_enter(old_row, 0);
+	}
+	if (row && row->type->ev_mouse) {
+		return row->type->ev_mouse(row, new_x, new_y, old_x, old_y);
+	}
+	if (row != old_row && row && row->type->ev_enter) {
+		row->type->ev_enter(row, 1);
 	}
 	return false;
 }
 
-struct vtk2_block *_vtk2_make_box(struct vtk2_box_settings settings) {
-	struct vtk2_b_box *box = malloc(sizeof *box);
-	if (!box) abort();
-	*box = (struct vtk2_b_box){
-		.children = settings.children,
-		.direction = settings.direction,
+static _Bool _vtk2_list_ev_scroll(struct vtk2_block *base, float dx, float dy) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, base);
+	struct vtk2_block *row = _vtk2_list_row(list, list->base.win->cx, list->base.win->cy);
+	if (row && row->type->ev_scroll && row->type->ev_scroll(row, dx, dy)) {
+		return true;
+	}
+	if (dy == 0) return false;
+	_vtk2_list_scroll_by(list, -dy * VTK2_LIST_SCROLL_ROWS * list->row_height);
+	return true;
+}
+
+void vtk2_list_set_count(struct vtk2_block *block, size_t count) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, block);
+	atomic_store(&list->count, count);
+	atomic_store(&list->rebind, 1);
+	vtk2_block_invalidate(block);
+}
+
+void vtk2_list_scroll_to(struct vtk2_block *block, double offset) {
+	struct vtk2_b_list *list = fieldParentPtr(struct vtk2_b_list, base, block);
+	atomic_store(&list->scroll, offset);
+	vtk2_block_invalidate(block);
+}
+
+static const struct vtk2_block_type _vtk2_list_type = {
+	.init = _vtk2_list_init,
+	.deinit = _vtk2_list_deinit,
+	.draw = _vtk2_list_draw,
+	.measure = _vtk2_list_measure,
+	.layout = _vtk2_list_layout,
+	.commit = _vtk2_list_commit,
+	.ev_button = _vtk2_list_ev_button,
+	.ev_enter = _vtk2_list_ev_enter,
+	.ev_mouse = _vtk2_list_ev_mouse,
+	.ev_scroll = _vtk2_list_ev_scroll,
+};
+
+static void _vtk2_list_setup(struct vtk2_b_list *list, struct vtk2_list_settings settings) {
+	*list = (struct vtk2_b_list){
+		.count = settings.count,
+		.row_height = settings.row_height,
+		.row_new = settings.row_new,
+		.row_bind = settings.row_bind,
+		.row_free = settings.row_free,
+		.data = settings.data,
 		.base = (struct vtk2_block){
 			.grow = settings.grow,
 			.margins = {UNPACK_4(settings.margins)},
 			.size = {UNPACK_2(settings.size)},
-
-			.init = _vtk2_box_init,
-			.deinit = _vtk2_box_deinit,
-			.draw = _vtk2_box_draw,
-			.layout = _vtk2_box_layout,
-			.ev_button = _vtk2_box_ev_button,
-			.ev_enter = _vtk2_box_ev_enter,
-			.ev_key = _vtk2_box_ev_key,
-			.ev_mouse = _vtk2_box_ev_mouse,
-			.ev_text = _vtk2_box_ev_text,
+			.type = &_vtk2_list_type,
 		},
 	};
-	return &box->base;
+}
+
+struct vtk2_block *_vtk2_make_list(struct vtk2_list_settings settings) {
+	struct vtk2_b_list *list = malloc(sizeof *list);
+	if (!list) abort();
+	_vtk2_list_setup(list, settings);
+	return &list->base;
+}
+
+enum vtk2_err _vtk2_new_list(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_list_settings settings) {
+	struct vtk2_b_list *list = vtk2_arena_alloc(arena, sizeof *list);
+	if (!list) return VTK2_ERR_ALLOC;
+	_vtk2_list_setup(list, settings);
+	*out = &list->base;
+	return 0;
+}
+
+//// Text measurement ////
+// FNV-1a, mixed with the font and size so one hash identifies the whole key
+static uint64_t _vtk2_text_hash(int font, float size, const char *str, size_t len) {
+	uint64_t h = 0xcbf29ce484222325;
+	for (size_t i = 0; i < len; i++) {
+		h = (h ^ (unsigned char)str[i]) * 0x100000001b3;
+	}
+	uint32_t size_bits;
+	memcpy(&size_bits, &size, sizeof size_bits);
+	h = (h ^ (uint32_t)font) * 0x100000001b3;
+	h = (h ^ size_bits) * 0x100000001b3;
+	return h ? h : 1; // 0 marks an empty slot
+}
+
+static void _vtk2_text_cache_insert(struct vtk2_text_metrics *cache, size_t cap, const struct vtk2_text_metrics *m) {
+	size_t i = m->hash & (cap - 1);
+	while (cache[i].hash) i = (i + 1) & (cap - 1);
+	cache[i] = *m;
+}
+
+static void _vtk2_text_cache_clear(struct vtk2_win *win) {
+	for (size_t i = 0; i < win->text_cache_cap; i++) {
+		free(win->text_cache[i].str);
+	}
+}
+
+// Make room for another entry in the text cache, returning false if the cache can't be used
+static _Bool _vtk2_text_cache_reserve(struct vtk2_win *win) {
+	if (2 * (win->text_cache_len + 1) <= win->text_cache_cap) return 1;
+
+	if (win->text_cache_cap >= VTK2_TEXT_CACHE_MAX) {
+		// Full; start over rather than tracking usage
+		_vtk2_text_cache_clear(win);
+		memset(win->text_cache, 0, win->text_cache_cap * sizeof *win->text_cache);
+		win->text_cache_len = 0;
+		return 1;
+	}
+
+	size_t cap = win->text_cache_cap ? 2 * win->text_cache_cap : 64;
+	struct vtk2_text_metrics *cache = calloc(cap, sizeof *cache);
+	if (!cache) return 0;
+
+	for (size_t i = 0; i < win->text_cache_cap; i++) {
+		if (win->text_cache[i].hash) {
+			_vtk2_text_cache_insert(cache, cap, &win->text_cache[i]);
+		}
+	}
+	free(win->text_cache);
+	win->text_cache = cache;
+	win->text_cache_cap = cap;
+	return 1;
+}
+
+// Measure a string, reusing previous results for the same font, size and text
+static void _vtk2_measure_text(struct vtk2_win *win, int font, float size, const char *str, const char *end, struct vtk2_text_metrics *out) {
+	size_t len = end ? (size_t)(end - str) : strlen(str);
+	uint64_t hash = _vtk2_text_hash(font, size, str, len);
+
+	// Blocks may be measured from several layout threads at once
+	mtx_lock(&win->text_lock);
+	if (win->text_cache_cap) {
+		for (size_t i = hash & (win->text_cache_cap - 1); win->text_cache[i].hash; i = (i + 1) & (win->text_cache_cap - 1)) {
+			struct vtk2_text_metrics *m = &win->text_cache[i];
+			if (m->hash == hash && m->len == len && m->font == font && m->size == size && !memcmp(m->str, str, len)) {
+				*out = *m;
+				out->str = NULL; // Only valid under the lock
+				mtx_unlock(&win->text_lock);
+				return;
+			}
+		}
+	}
+	mtx_unlock(&win->text_lock);
+
+	NVGcontext *vg = win->vg;
+	mtx_lock(&win->vg_lock);
+	nvgFontFaceId(vg, font);
+	nvgFontSize(vg, size);
+
+	// Only the size is cached, which doesn't depend on where the text is placed
+	float rect[4];
+	nvgTextBounds(vg, 0, 0, str, str + len, rect);
+	mtx_unlock(&win->vg_lock);
+	VTK2_PROF_COUNT(win, text_bounds_calls);
+
+	*out = (struct vtk2_text_metrics){
+		.hash = hash,
+		.len = len,
+		.font = font,
+		.size = size,
+		.w = rect[2] - rect[0],
+		.h = rect[3] - rect[1],
+	};
+
+	// The cached entry keeps its own copy of the text; hits compare it so a hash collision can't return the wrong metrics
+	struct vtk2_text_metrics entry = *out;
+	entry.str = malloc(len ? len : 1);
+	if (!entry.str) return;
+	memcpy(entry.str, str, len);
+
+	mtx_lock(&win->text_lock);
+	if (_vtk2_text_cache_reserve(win)) {
+		_vtk2_text_cache_insert(win->text_cache, win->text_cache_cap, &entry);
+		win->text_cache_len++;
+	} else {
+		free(entry.str);
+	}
+	mtx_unlock(&win->text_lock);
+}
+
+//// Fonts ////
+// Fonts are loaded once per process and shared by every window; each nanovg context refers to the same bytes
+struct vtk2_font {
+	struct vtk2_font *next;
+	char *name;
+	const unsigned char *data;
+	size_t size;
+};
+
+static struct vtk2_font *_vtk2_fonts;
+static mtx_t _vtk2_fonts_lock;
+static once_flag _vtk2_fonts_once = ONCE_FLAG_INIT;
+static void _vtk2_fonts_init(void) {
+	mtx_init(&_vtk2_fonts_lock, mtx_plain);
 }
 
 const char aileron_data[];
 const size_t aileron_size;
-//// Static text block ////
-static enum vtk2_err _vtk2_static_text_init(struct vtk2_block *base) {
-	struct vtk2_b_static_text *text = fieldParentPtr(struct vtk2_b_static_text, base, base);
 
-	const char *font_name, *font_data = NULL;
-	size_t data_size;
-	if (text->font_file) {
-		font_name = text->font_file;
-		if (text->font_data) {
-			font_data = text->font_data;
-			data_size = text->data_size;
+#define VTK2_AILERON_NAME "\xff_vtk2_font_aileron"
+
+static enum vtk2_err _vtk2_font_read(const char *path, const unsigned char **data, size_t *size) {
+	FILE *f;
+#ifdef VTK2_MMAP
+	// Map the file read-only, so pages are only faulted in for the glyphs we actually use,
+	// and are shared with every other process using the same font through the page cache.
+	// Falls back to reading the file if it can't be mapped (eg. it's a pipe)
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return VTK2_ERR_LOAD_FAILED;
+
+	struct stat st;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0) goto fallback;
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) goto fallback;
+	close(fd); // The mapping holds its own reference to the file
+
+	// Glyph lookups jump around the file, so readahead would mostly fetch tables we never touch
+	posix_madvise(map, st.st_size, POSIX_MADV_RANDOM);
+
+	*data = map;
+	*size = st.st_size;
+	return 0;
+
+fallback:
+	// Keep reading from the descriptor we have; reopening a pipe would wait for another writer
+	f = fdopen(fd, "rb");
+	if (!f) {
+		close(fd);
+		return VTK2_ERR_LOAD_FAILED;
+	}
+#else
+	f = fopen(path, "rb");
+	if (!f) return VTK2_ERR_LOAD_FAILED;
+#endif
+
+	// Read in chunks until EOF, since the size of a stream can't always be found up front
+	enum vtk2_err err = 0;
+	unsigned char *buf = NULL;
+	size_t len = 0, cap = 0;
+	do {
+		if (len == cap) {
+			cap = cap ? 2 * cap : 64 * 1024;
+			unsigned char *new_buf = realloc(buf, cap);
+			if (!new_buf) {
+				err = VTK2_ERR_ALLOC;
+				break;
+			}
+			buf = new_buf;
 		}
+		len += fread(buf + len, 1, cap - len, f);
+	} while (!feof(f) && !ferror(f));
+
+	if (!err && (ferror(f) || len == 0)) err = VTK2_ERR_LOAD_FAILED;
+	fclose(f);
+
+	if (err) {
+		free(buf);
+		return err;
+	}
+	*data = buf;
+	*size = len;
+	return 0;
+}
+
+// Find a font in the registry, loading it if this is the first use
+// name must be unique to the font. If data is NULL, name is the path of the font file
+static enum vtk2_err _vtk2_font_find(const char *name, const char *data, size_t size, struct vtk2_font **out) {
+	call_once(&_vtk2_fonts_once, _vtk2_fonts_init);
+	mtx_lock(&_vtk2_fonts_lock);
+
+	enum vtk2_err err = 0;
+	struct vtk2_font *font;
+	for (font = _vtk2_fonts; font; font = font->next) {
+		if (!strcmp(font->name, name)) goto done;
+	}
+
+	err = VTK2_ERR_ALLOC;
+	font = calloc(1, sizeof *font);
+	if (!font) goto done;
+	font->name = malloc(strlen(name) + 1);
+	if (!font->name) goto fail;
+	strcpy(font->name, name);
+
+	if (data) {
+		// In-memory fonts are used in place
+		font->data = (const unsigned char *)data;
+		font->size = size;
 	} else {
-		font_name = "\xff_vtk2_font_aileron";
-		font_data = aileron_data;
-		data_size = aileron_size;
+		// Font files are mapped or read once and never released, since any window may still be using them
+		if ((err = _vtk2_font_read(name, &font->data, &font->size))) goto fail;
 	}
 
-	NVGcontext *vg = text->base.win->vg;
-	text->font_handle = nvgFindFont(vg, font_name);
-	if (text->font_handle == -1) {
-		if (font_data) {
-			text->font_handle = nvgCreateFontMem(vg, font_name, (unsigned char *)font_data, data_size, 0);
-		} else {
-			text->font_handle = nvgCreateFont(vg, font_name, font_name);
-		}
-		if (text->font_handle == -1) {
-			return VTK2_ERR_LOAD_FAILED;
-		}
+	font->next = _vtk2_fonts;
+	_vtk2_fonts = font;
+	err = 0;
+	goto done;
+
+fail:
+	free(font->name);
+	free(font);
+	font = NULL;
+done:
+	mtx_unlock(&_vtk2_fonts_lock);
+	*out = font;
+	return err;
+}
+
+// Get the window's handle for a font, as described by VTK2_FONT_SETTINGS
+static enum vtk2_err _vtk2_font_load(struct vtk2_win *win, const char *file, const char *data, size_t size, int *handle) {
+	if (!file) {
+		file = VTK2_AILERON_NAME;
+		data = aileron_data;
+		size = aileron_size;
 	}
 
+	*handle = nvgFindFont(win->vg, file);
+	if (*handle != -1) return 0;
+
+	struct vtk2_font *font;
+	enum vtk2_err err = _vtk2_font_find(file, data, size, &font);
+	if (err) return err;
+
+	// The registry owns the data, so nanovg must not free it
+	*handle = nvgCreateFontMem(win->vg, file, (unsigned char *)font->data, font->size, 0);
+	return *handle == -1 ? VTK2_ERR_LOAD_FAILED : 0;
+}
+
+enum vtk2_err vtk2_window_prewarm(struct vtk2_win *win, const char *font_file, const char *font_data, size_t data_size, float font_size, const char *chars) {
+	int handle;
+	enum vtk2_err err = _vtk2_font_load(win, font_file, font_data, data_size, &handle);
+	if (err) return err;
+
+	// Drawing text is the only way to get nanovg to rasterize glyphs; the frame is thrown away, but the atlas isn't
+	_vtk2_window_make_current(win);
+	mtx_lock(&win->vg_lock);
+	nvgBeginFrame(win->vg, win->win_w, win->win_h, win->win_w / (float)win->fb_w);
+	nvgFontFaceId(win->vg, handle);
+	nvgFontSize(win->vg, font_size);
+	nvgText(win->vg, 0, 0, chars, NULL);
+	nvgCancelFrame(win->vg);
+	mtx_unlock(&win->vg_lock);
 	return 0;
 }
 
-static void _vtk2_static_text_layout(struct vtk2_block *base, enum vtk2_shrink shrink) {
+// Distance from the top of a line to the baseline
+static float _vtk2_font_ascend(struct vtk2_win *win, int font, float size) {
+	float ascend;
+	nvgFontFaceId(win->vg, font);
+	nvgFontSize(win->vg, size);
+	nvgTextMetrics(win->vg, &ascend, NULL, NULL);
+	return ascend;
+}
+
+//// Static text block ////
+static enum vtk2_err _vtk2_static_text_init(struct vtk2_block *base) {
 	struct vtk2_b_static_text *text = fieldParentPtr(struct vtk2_b_static_text, base, base);
-	NVGcontext *vg = text->base.win->vg;
 
-	nvgFontFaceId(vg, text->font_handle);
-	nvgFontSize(vg, text->font_size);
+	enum vtk2_err err = _vtk2_font_load(text->base.win, text->font_file, text->font_data, text->data_size, &text->font_handle);
+	if (err) return err;
 
-	float ascend;
-	nvgTextMetrics(vg, &ascend, NULL, NULL);
+	text->ascend = _vtk2_font_ascend(text->base.win, text->font_handle, text->font_size);
+	return 0;
+}
 
-	float rect[4];
-	nvgTextBounds(vg, text->base.rect[0], text->base.rect[1] + ascend, text->text, NULL, rect);
+static void _vtk2_static_text_measure(struct vtk2_block *base) {
+	struct vtk2_b_static_text *text = fieldParentPtr(struct vtk2_b_static_text, base, base);
+
+	struct vtk2_text_metrics m;
+	_vtk2_measure_text(text->base.win, text->font_handle, text->font_size, text->text, NULL, &m);
 
-	text->base.rect[2] = rect[2] - rect[0];
-	text->base.rect[3] = rect[3] - rect[1];
+	text->base.pref[0] = m.w;
+	text->base.pref[1] = m.h;
 
-	_vtk2_block_constrain(&text->base);
+	_vtk2_block_clamp(&text->base, text->base.pref);
 }
 
 static void _vtk2_static_text_draw(struct vtk2_block *base) {
@@ -568,15 +3326,18 @@ static void _vtk2_static_text_draw(struct vtk2_block *base) {
 	nvgFontSize(vg, text->font_size);
 	nvgFillColor(vg, nvgRGBAf(UNPACK_4(text->font_color)));
 
-	float ascend;
-	nvgTextMetrics(vg, &ascend, NULL, NULL);
-
-	nvgText(vg, text->base.rect[0], text->base.rect[1] + ascend, text->text, NULL);
+	nvgText(vg, text->base.draw_rect[0], text->base.draw_rect[1] + text->ascend, text->text, NULL);
 }
 
-struct vtk2_block *_vtk2_make_static_text(struct vtk2_static_text_settings settings) {
-	struct vtk2_b_static_text *text = malloc(sizeof *text);
-	if (!text) abort();
+static const struct vtk2_block_type _vtk2_static_text_type = {
+	.init = _vtk2_static_text_init,
+	.draw = _vtk2_static_text_draw,
+	.retain = 1,
+	.measure = _vtk2_static_text_measure,
+	.layout = _vtk2_block_fit,
+};
+
+static void _vtk2_static_text_setup(struct vtk2_b_static_text *text, struct vtk2_static_text_settings settings) {
 	*text = (struct vtk2_b_static_text){
 		.text = settings.text,
 		.font_size = settings.font_size,
@@ -591,95 +3352,165 @@ struct vtk2_block *_vtk2_make_static_text(struct vtk2_static_text_settings setti
 			.grow = settings.grow,
 			.margins = {UNPACK_4(settings.margins)},
 			.size = {UNPACK_2(settings.size)},
-
-			.init = _vtk2_static_text_init,
-			.draw = _vtk2_static_text_draw,
-			.layout = _vtk2_static_text_layout,
+			.type = &_vtk2_static_text_type,
 		},
 	};
+}
+
+struct vtk2_block *_vtk2_make_static_text(struct vtk2_static_text_settings settings) {
+	struct vtk2_b_static_text *text = malloc(sizeof *text);
+	if (!text) abort();
+	_vtk2_static_text_setup(text, settings);
 	return &text->base;
 }
 
+enum vtk2_err _vtk2_new_static_text(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_static_text_settings settings) {
+	struct vtk2_b_static_text *text = vtk2_arena_alloc(arena, sizeof *text);
+	if (!text) return VTK2_ERR_ALLOC;
+	_vtk2_static_text_setup(text, settings);
+	*out = &text->base;
+	return 0;
+}
+
 //// Text block ////
-static enum vtk2_err _vtk2_text_init(struct vtk2_block *base) {
-	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
+// Copy a string into the block's buffer
+static enum vtk2_err _vtk2_text_store(struct vtk2_b_text *text, const char *str, size_t len) {
+	if (len == SIZE_MAX) len = strlen(str);
+	if (len >= text->cap) {
+		size_t cap = text->cap ? text->cap : 32;
+		while (cap <= len) cap *= 2;
+		char *buf = realloc(text->buf, cap);
+		if (!buf) return VTK2_ERR_ALLOC;
+		text->buf = buf;
+		text->cap = cap;
+	}
+	memcpy(text->buf, str, len);
+	text->buf[len] = 0;
+	text->len = len;
+	return 0;
+}
 
-	const char *font_name, *font_data = NULL;
-	size_t data_size;
-	if (text->font_file) {
-		font_name = text->font_file;
-		if (text->font_data) {
-			font_data = text->font_data;
-			data_size = text->data_size;
-		}
+// Ask the user for the current text, returning whether it changed
+// If force is set, the text is always copied
+static _Bool _vtk2_text_changed(struct vtk2_b_text *text, _Bool force, enum vtk2_err *err) {
+	size_t len = SIZE_MAX;
+	const char *str;
+	if (text->text_gen_fn) {
+		// A forced fetch must produce the text, so report a generation no producer can hold
+		uint64_t gen = force ? UINT64_MAX : text->gen;
+		str = text->text_gen_fn(&len, &gen, text->data);
+		VTK2_PROF_COUNT(text->base.win, text_fn_calls);
+		if (!force && gen == text->gen) return 0;
+		text->gen = gen;
+		if (!str) str = "";
+	} else if (text->text_fn) {
+		str = text->text_fn(&len, text->data);
+		VTK2_PROF_COUNT(text->base.win, text_fn_calls);
+		if (len == SIZE_MAX) len = strlen(str);
+		if (!force && text->buf && len == text->len && !memcmp(str, text->buf, len)) return 0;
+		text->gen++;
 	} else {
-		font_name = "\xff_vtk2_font_aileron";
-		font_data = aileron_data;
-		data_size = aileron_size;
+		return 0;
 	}
 
-	NVGcontext *vg = text->base.win->vg;
-	text->font_handle = nvgFindFont(vg, font_name);
-	if (text->font_handle == -1) {
-		if (font_data) {
-			text->font_handle = nvgCreateFontMem(vg, font_name, (unsigned char *)font_data, data_size, 0);
-		} else {
-			text->font_handle = nvgCreateFont(vg, font_name, font_name);
-		}
-		if (text->font_handle == -1) {
-			return VTK2_ERR_LOAD_FAILED;
-		}
+	*err = _vtk2_text_store(text, str, len);
+	return !*err;
+}
+
+static enum vtk2_err _vtk2_text_fetch(struct vtk2_b_text *text, _Bool force) {
+	enum vtk2_err err = 0;
+	_vtk2_text_changed(text, force, &err);
+	return err;
+}
+
+// Called at the start of each frame; relayout only if the text changed
+static void _vtk2_text_poll(struct vtk2_block *base) {
+	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
+	enum vtk2_err err = 0;
+	if (_vtk2_text_changed(text, 0, &err)) {
+		_vtk2_block_mark(&text->base);
 	}
+	// On allocation failure, keep showing the old text
+}
 
+static enum vtk2_err _vtk2_text_init(struct vtk2_block *base) {
+	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
+
+	enum vtk2_err err = _vtk2_font_load(text->base.win, text->font_file, text->font_data, text->data_size, &text->font_handle);
+	if (err) return err;
+	text->ascend = _vtk2_font_ascend(text->base.win, text->font_handle, text->font_size);
+
+	// Fetch the initial text
+	err = _vtk2_text_fetch(text, 1);
+	if (err) return err;
+
+	if (text->text_fn || text->text_gen_fn) {
+		return _vtk2_window_add_poll(text->base.win, &text->base, _vtk2_text_poll);
+	}
 	return 0;
 }
 
-static void _vtk2_text_layout(struct vtk2_block *base, enum vtk2_shrink shrink) {
-	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
-	NVGcontext *vg = text->base.win->vg;
+static void _vtk2_text_deinit(struct vtk2_block *base) {
+	// The text stays, since it may have been set directly rather than fetched again on init
+	_vtk2_window_remove_poll(base->win, base);
+}
 
-	nvgFontFaceId(vg, text->font_handle);
-	nvgFontSize(vg, text->font_size);
+static void _vtk2_text_release(struct vtk2_block *base) {
+	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
+	free(text->buf);
+	text->buf = NULL;
+	text->len = text->cap = 0;
+}
 
-	float ascend;
-	nvgTextMetrics(vg, &ascend, NULL, NULL);
+static void _vtk2_text_measure(struct vtk2_block *base) {
+	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
 
-	size_t len = SIZE_MAX;
-	const char *str = text->text_fn(&len, text->data);
-	const char *end = (len == SIZE_MAX) ? NULL : str + len;
+	const char *str = text->buf ? text->buf : "";
 
-	float rect[4];
-	nvgTextBounds(vg, text->base.rect[0], text->base.rect[1] + ascend, str, end, rect);
+	struct vtk2_text_metrics m;
+	_vtk2_measure_text(text->base.win, text->font_handle, text->font_size, str, str + text->len, &m);
 
-	text->base.rect[2] = rect[2] - rect[0];
-	text->base.rect[3] = rect[3] - rect[1];
+	text->base.pref[0] = m.w;
+	text->base.pref[1] = m.h;
 
-	_vtk2_block_constrain(&text->base);
+	_vtk2_block_clamp(&text->base, text->base.pref);
 }
 
 static void _vtk2_text_draw(struct vtk2_block *base) {
 	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, base);
+	if (!text->buf) return;
 
 	NVGcontext *vg = text->base.win->vg;
 	nvgFontFaceId(vg, text->font_handle);
 	nvgFontSize(vg, text->font_size);
 	nvgFillColor(vg, nvgRGBAf(UNPACK_4(text->font_color)));
 
-	float ascend;
-	nvgTextMetrics(vg, &ascend, NULL, NULL);
-
-	size_t len = SIZE_MAX;
-	const char *str = text->text_fn(&len, text->data);
-	const char *end = (len == SIZE_MAX) ? NULL : str + len;
+	nvgText(vg, text->base.draw_rect[0], text->base.draw_rect[1] + text->ascend, text->buf, text->buf + text->len);
+}
 
-	nvgText(vg, text->base.rect[0], text->base.rect[1] + ascend, str, end);
+enum vtk2_err vtk2_text_set(struct vtk2_block *block, const char *str, size_t len) {
+	struct vtk2_b_text *text = fieldParentPtr(struct vtk2_b_text, base, block);
+	enum vtk2_err err = _vtk2_text_store(text, str, len);
+	if (err) return err;
+	text->gen++;
+	vtk2_block_invalidate(block);
+	return 0;
 }
 
-struct vtk2_block *_vtk2_make_text(struct vtk2_text_settings settings) {
-	struct vtk2_b_text *text = malloc(sizeof *text);
-	if (!text) abort();
+static const struct vtk2_block_type _vtk2_text_type = {
+	.init = _vtk2_text_init,
+	.deinit = _vtk2_text_deinit,
+	.release = _vtk2_text_release,
+	.draw = _vtk2_text_draw,
+	.retain = 1,
+	.measure = _vtk2_text_measure,
+	.layout = _vtk2_block_fit,
+};
+
+static void _vtk2_text_setup(struct vtk2_b_text *text, struct vtk2_text_settings settings) {
 	*text = (struct vtk2_b_text){
 		.text_fn = settings.text_fn,
+		.text_gen_fn = settings.text_gen_fn,
 		.data = settings.data,
 
 		.font_size = settings.font_size,
@@ -693,15 +3524,120 @@ struct vtk2_block *_vtk2_make_text(struct vtk2_text_settings settings) {
 			.grow = settings.grow,
 			.margins = {UNPACK_4(settings.margins)},
 			.size = {UNPACK_2(settings.size)},
-
-			.init = _vtk2_text_init,
-			.draw = _vtk2_text_draw,
-			.layout = _vtk2_text_layout,
+			.type = &_vtk2_text_type,
 		},
 	};
+}
+
+struct vtk2_block *_vtk2_make_text(struct vtk2_text_settings settings) {
+	struct vtk2_b_text *text = malloc(sizeof *text);
+	if (!text) abort();
+	_vtk2_text_setup(text, settings);
 	return &text->base;
 }
 
+enum vtk2_err _vtk2_new_text(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_text_settings settings) {
+	struct vtk2_b_text *text = vtk2_arena_alloc(arena, sizeof *text);
+	if (!text) return VTK2_ERR_ALLOC;
+	_vtk2_text_setup(text, settings);
+	*out = &text->base;
+	return 0;
+}
+
+//// Profiler block ////
+#ifdef VTK2_PROFILE
+// Keep the graph up to date whenever a frame is drawn, without causing frames itself
+static void _vtk2_profiler_poll(struct vtk2_block *base) {
+	_vtk2_window_damage(base->win, base->draw_rect);
+}
+
+static enum vtk2_err _vtk2_profiler_init(struct vtk2_block *base) {
+	return _vtk2_window_add_poll(base->win, base, _vtk2_profiler_poll);
+}
+
+static void _vtk2_profiler_deinit(struct vtk2_block *base) {
+	_vtk2_window_remove_poll(base->win, base);
+}
+
+static void _vtk2_profiler_draw(struct vtk2_block *base) {
+	struct vtk2_b_profiler *prof = fieldParentPtr(struct vtk2_b_profiler, base, base);
+	NVGcontext *vg = prof->base.win->vg;
+	float x = prof->base.draw_rect[0], y = prof->base.draw_rect[1];
+	float w = prof->base.draw_rect[2], h = prof->base.draw_rect[3];
+
+	nvgBeginPath(vg);
+	nvgRect(vg, x, y, w, h);
+	nvgFillColor(vg, nvgRGBA(0, 0, 0, 160));
+	nvgFill(vg);
+
+	// One bar per frame, newest on the right, stacked by phase
+	static const unsigned char colors[][3] = {
+		{150, 150, 150}, // poll
+		{50, 130, 255}, // layout
+		{80, 230, 80}, // draw
+		{255, 200, 50}, // flush
+		{255, 80, 80}, // swap
+	};
+	struct vtk2_frame_stats frames[VTK2_PROFILE_FRAMES];
+	size_t bar_w = 2;
+	size_t n = vtk2_window_stats(prof->base.win, frames, (size_t)fmaxf(0, fminf(w / bar_w, VTK2_PROFILE_FRAMES)));
+	for (size_t i = 0; i < n; i++) {
+		struct vtk2_frame_stats *f = &frames[i];
+		double phases[] = {f->poll, f->layout, f->draw, f->flush, f->swap};
+		float bx = x + w - (n - i) * bar_w, by = y + h;
+		for (int j = 0; j < 5; j++) {
+			float bh = fminf(by - y, h * phases[j] / prof->max_time);
+			by -= bh;
+			nvgBeginPath(vg);
+			nvgRect(vg, bx, by, bar_w, bh);
+			nvgFillColor(vg, nvgRGBA(UNPACK_3(colors[j]), 255));
+			nvgFill(vg);
+		}
+	}
+
+	// Frame budget line, halfway up
+	nvgBeginPath(vg);
+	nvgMoveTo(vg, x, y + h / 2);
+	nvgLineTo(vg, x + w, y + h / 2);
+	nvgStrokeColor(vg, nvgRGBA(255, 255, 255, 100));
+	nvgStrokeWidth(vg, 1);
+	nvgStroke(vg);
+}
+
+static const struct vtk2_block_type _vtk2_profiler_type = {
+	.init = _vtk2_profiler_init,
+	.deinit = _vtk2_profiler_deinit,
+	.draw = _vtk2_profiler_draw,
+};
+
+static void _vtk2_profiler_setup(struct vtk2_b_profiler *prof, struct vtk2_profiler_settings settings) {
+	*prof = (struct vtk2_b_profiler){
+		.max_time = settings.max_time,
+		.base = (struct vtk2_block){
+			.grow = settings.grow,
+			.margins = {UNPACK_4(settings.margins)},
+			.size = {UNPACK_2(settings.size)},
+			.type = &_vtk2_profiler_type,
+		},
+	};
+}
+
+struct vtk2_block *_vtk2_make_profiler(struct vtk2_profiler_settings settings) {
+	struct vtk2_b_profiler *prof = malloc(sizeof *prof);
+	if (!prof) abort();
+	_vtk2_profiler_setup(prof, settings);
+	return &prof->base;
+}
+
+enum vtk2_err _vtk2_new_profiler(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_profiler_settings settings) {
+	struct vtk2_b_profiler *prof = vtk2_arena_alloc(arena, sizeof *prof);
+	if (!prof) return VTK2_ERR_ALLOC;
+	_vtk2_profiler_setup(prof, settings);
+	*out = &prof->base;
+	return 0;
+}
+#endif
+
 // Aileron Regular //
 const char aileron_data[] = {
 	79,84,84,79,0,12,0,128,0,3,0,64,67,70,70,32,81,71,116,38,0,0,0,212,0,0,22,111,71,68,69,70,0,17,0,53,
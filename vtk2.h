@@ -47,6 +47,7 @@
 #include <math.h>
 #include <stdatomic.h>
 #include <stdint.h>
+#include <threads.h>
 #include <GLFW/glfw3.h>
 #include "deps/nanovg/src/nanovg.h"
 
@@ -68,6 +69,7 @@ void vtk2_perror(const char *prefix, enum vtk2_err err);
 
 struct vtk2_block;
 struct vtk2_win;
+struct vtk2_app;
 
 // Create a new window with the specified title, width and height.
 // Some default GLFW window hints will be set.
@@ -84,22 +86,93 @@ enum vtk2_err vtk2_window_init(struct vtk2_win *win, const char *title, int w, i
 // and should not be destroyed except through vtk2_window_deinit.
 enum vtk2_err vtk2_window_init_glfw(struct vtk2_win *win, GLFWwindow *glfw_win);
 
+// Create a window with no on-screen surface, which renders into an offscreen framebuffer of the specified size.
+// This uses a surfaceless EGL context, so needs no display and works with software drivers such as llvmpipe.
+// Headless windows receive no events; drive them with vtk2_window_draw instead of vtk2_window_mainloop.
+// Only available if vtk2 is compiled with VTK2_HEADLESS defined.
+enum vtk2_err vtk2_window_init_headless(struct vtk2_win *win, int w, int h);
+
+// Read back the contents of the window's framebuffer.
+// Pixels are written top to bottom as premultiplied RGBA8, with no padding, so pixels must hold fb_w * fb_h * 4 bytes.
+enum vtk2_err vtk2_window_read_pixels(struct vtk2_win *win, uint8_t *pixels);
+
 // Destroy the specified window, cleaning up all resources associated with it.
+// The root block is deinitialized and released (see vtk2_block_release), so it can then be freed.
 void vtk2_window_deinit(struct vtk2_win *win);
 
 // Initialize a block and set it as the root block of the specified window.
 // If this function succeeds, the block becomes owned by the window.
+// Any previous root is deinitialized and handed back; release it with vtk2_block_release before freeing it.
 enum vtk2_err vtk2_window_set_root(struct vtk2_win *win, struct vtk2_block *root);
 
 // Process events and redraws for the specified window until it is closed.
 void vtk2_window_mainloop(struct vtk2_win *win);
 
-// Force an immediate redraw of the specified window.
+// Lay out and draw a frame, if anything has changed since the last one. Returns true if a frame was drawn.
+// Input received since the last frame is delivered to the root block first, in the order it arrived.
+// This is done automatically by vtk2_window_mainloop.
+_Bool vtk2_window_draw(struct vtk2_win *win);
+
+// Force an immediate redraw of the entire window.
 // May be called concurrently.
 void vtk2_window_redraw(struct vtk2_win *win);
 
+// Schedule a redraw of only the parts of the window that have been invalidated.
+// Requests made before the next frame starts are coalesced into that frame, so this is cheap to call often.
+// May be called concurrently.
+void vtk2_window_update(struct vtk2_win *win);
+
+// Limit vtk2_window_mainloop to at most fps frames per second.
+// If fps is 0 (the default), frames are limited to the refresh rate of the display.
+void vtk2_window_set_max_fps(struct vtk2_win *win, double fps);
+
+// Set a function to be called by vtk2_window_mainloop at the start of every frame, before layout.
+// Changes made by fn appear in that frame, so producers can batch their updates here instead of
+// calling vtk2_window_update for each one. deadline is the glfwGetTime at which the next frame may start.
+void vtk2_window_on_frame(struct vtk2_win *win, void (*fn)(struct vtk2_win *win, double deadline, void *data), void *data);
+
+// Get the glfwGetTime at which the next frame may start. May be called concurrently.
+double vtk2_window_frame_deadline(struct vtk2_win *win);
+
+// Move layout onto a separate thread, so a slow layout doesn't hold up drawing or input.
+// While a layout is running, the window keeps drawing the results of the last one to finish.
+// Once this is enabled, blocks may only be changed while the layout thread is idle: from text functions,
+// or between vtk2_window_lock and vtk2_window_unlock. Custom draw and event callbacks must use draw_rect, not rect.
+enum vtk2_err vtk2_window_async_layout(struct vtk2_win *win);
+
+// Rasterize the glyphs for every character in chars ahead of time, so the first frame to use them doesn't stall.
+// The font is specified as in VTK2_FONT_SETTINGS; glyphs are rasterized at the window's current pixel ratio.
+enum vtk2_err vtk2_window_prewarm(struct vtk2_win *win, const char *font_file, const char *font_data, size_t data_size, float font_size, const char *chars);
+
+// Arrange large independent subtrees in parallel on nthreads threads, including the one doing the layout.
+// The result is identical to laying out on a single thread. Passing 0 or 1 turns this off again.
+enum vtk2_err vtk2_window_parallel_layout(struct vtk2_win *win, size_t nthreads);
+
+// Wait for any running layout to finish, and prevent another from starting until vtk2_window_unlock is called.
+// Must not be called from block callbacks.
+void vtk2_window_lock(struct vtk2_win *win);
+void vtk2_window_unlock(struct vtk2_win *win);
+
+// Initialize an app with no windows. An app runs the main loop for any number of windows on one thread.
+void vtk2_app_init(struct vtk2_app *app);
+
+// Add a window to an app. Headless windows cannot be added.
+// Windows in an app don't wait for vertical blank when swapping buffers, so drawing one doesn't hold up the rest;
+// they are paced by vtk2_window_set_max_fps instead.
+// The window must not be deinitialized until it has been closed or vtk2_app_run has returned.
+enum vtk2_err vtk2_app_add(struct vtk2_app *app, struct vtk2_win *win);
+
+// Process events and redraws for every window in the app until they have all been closed.
+// Closed windows are hidden and removed from the app, but not deinitialized.
+// Only windows that have been updated are visited, so idle windows cost nothing.
+void vtk2_app_run(struct vtk2_app *app);
+
 // Initialize a block
 enum vtk2_err vtk2_block_init(struct vtk2_win *win, struct vtk2_block *block);
+// Free what a block and its children keep across deinitialization, such as text set with vtk2_text_set and
+// box child lists, so the blocks can be freed. Call this on a block removed with vtk2_box_remove before freeing it
+// It must not be in a window. The blocks themselves are not freed, and are left empty
+void vtk2_block_release(struct vtk2_block *block);
 
 enum vtk2_shrink {
 	VTK2_SHRINK_NONE,
@@ -107,9 +180,48 @@ enum vtk2_shrink {
 	VTK2_SHRINK_Y,
 };
 
+// Layout happens in two passes, each of which visits every block once:
+// - The measure pass runs bottom-up, computing the preferred size of each block from its children
+// - The arrange pass runs top-down, dividing the space given to each box between its children
+//   Children are given their preferred size along the box's axis, and any leftover space is split
+//   between them according to their grow factors
+
+// Compute the preferred size of a block and all its children
+void vtk2_block_measure(struct vtk2_block *block);
+
+// Position a block and all its children within the provided rect, shrinking it to its preferred size
+// along the specified axis. The block must have been measured first
+void vtk2_block_arrange(struct vtk2_block *block, float rect[4], enum vtk2_shrink shrink);
+
 // Recompute block layout based on the provided rect and shrink
+// Equivalent to vtk2_block_measure followed by vtk2_block_arrange
 void vtk2_block_layout(struct vtk2_block *block, float rect[4], enum vtk2_shrink shrink);
 
+// Layout results are cached: blocks are only measured again if they have been invalidated,
+// and only arranged again if they were measured or the rect and shrink they are given change.
+
+// Mark a block and all its ancestors as needing layout, and schedule a redraw of the block
+// Call this whenever something that affects the size or appearance of a block changes
+// May be called concurrently
+void vtk2_block_invalidate(struct vtk2_block *block);
+
+//// Arenas ////
+// An arena holds the memory for any number of blocks, which are all freed together
+struct vtk2_arena_chunk;
+struct vtk2_arena {
+	struct vtk2_arena_chunk *chunk;
+};
+
+// Initialize an empty arena
+void vtk2_arena_init(struct vtk2_arena *arena);
+
+// Free all memory allocated from an arena
+// Any blocks in the arena must be deinitialized first, eg. by replacing the window's root block
+void vtk2_arena_deinit(struct vtk2_arena *arena);
+
+// Allocate memory from an arena, returning NULL on failure
+void *vtk2_arena_alloc(struct vtk2_arena *arena, size_t size);
+
 //// Block settings ////
 #define VTK2_BLOCK_SETTINGS \
 	float grow; \
@@ -121,6 +233,7 @@ void vtk2_block_layout(struct vtk2_block *block, float rect[4], enum vtk2_shrink
 	.size = {NAN, NAN}
 #pragma GCC diagnostic ignored "-Winitializer-overrides"
 #define _vtk2_make(name, ...) _vtk2_make_##name((struct vtk2_##name##_settings){VTK2_BLOCK_DEFAULTS, __VA_ARGS__})
+#define _vtk2_new(name, arena, out, ...) _vtk2_new_##name(arena, out, (struct vtk2_##name##_settings){VTK2_BLOCK_DEFAULTS, __VA_ARGS__})
 
 // Common options for all text-rendering blocks
 #define VTK2_FONT_SETTINGS \
@@ -128,6 +241,7 @@ void vtk2_block_layout(struct vtk2_block *block, float rect[4], enum vtk2_shrink
 	float font_color[4]; \
     /* If both font_file and font_data are NULL, a trimmed version of Aileron Regular will be used
 	 * If font_data is set, font_file will not be used, but *must still be set* to a string unique to that font
+	 * Fonts are loaded once and shared by every window, so font_data must stay valid until the process exits
      */ \
 	const char *font_file; /* Filename of font to use */ \
 	const char *font_data; /* In-memory font to use */ \
@@ -143,11 +257,15 @@ enum vtk2_direction { VTK2_ROW, VTK2_COL };
 struct vtk2_box_settings {
 	struct vtk2_block **children;
 	enum vtk2_direction direction;
+	// Render children into an offscreen layer, which is reused until something inside the box changes
+	// Worthwhile for complex subtrees that rarely change. Children are clipped to the box
+	_Bool layer;
 	VTK2_BLOCK_SETTINGS;
 };
 #define VTK2_BOX_DEFAULTS \
 	.children = NULL, \
-	.direction = VTK2_ROW
+	.direction = VTK2_ROW, \
+	.layer = 0
 
 struct vtk2_static_text_settings {
 	const char *text; // Text to display
@@ -162,8 +280,15 @@ struct vtk2_static_text_settings {
 struct vtk2_text_settings {
 	// This function is called to determine the text to render
 	// If the value returned through len is SIZE_MAX (which is the default), the string is assumed to be null-terminated
-	// This function will be called multiple times per frame, so it may be advisable to implement some form of caching
+	// It is called once at the start of each frame, and the result is copied; the block is only laid out and
+	// redrawn again if the text differs from last time. Use vtk2_window_update to schedule a frame after a change
 	const char *(*text_fn)(size_t *len, void *data);
+	// Like text_fn, but also reports a generation counter, which should change whenever the text does
+	// On entry, gen holds the generation the block last saw. If it is unchanged, the text is not compared
+	// or copied, and the function may return NULL instead of producing it
+	// When the block needs the text regardless (eg. on the first call), gen holds UINT64_MAX instead
+	// If this is set, text_fn is ignored
+	const char *(*text_gen_fn)(size_t *len, uint64_t *gen, void *data);
 	void *data;
 
 	VTK2_FONT_SETTINGS;
@@ -171,60 +296,391 @@ struct vtk2_text_settings {
 };
 #define VTK2_TEXT_DEFAULTS \
 	.text_fn = NULL, \
+	.text_gen_fn = NULL, \
 	.data = NULL, \
 	VTK2_FONT_DEFAULTS
 
+// A vertically scrolling list of equal-height rows
+// Only rows that are on screen exist; they are created as needed and reused for different items as the list scrolls
+struct vtk2_list_settings {
+	size_t count; // Number of items in the list
+	float row_height; // Height of every row, including margins
+	// Create a new row; it is bound to an item before it is laid out or drawn. Return NULL on failure
+	struct vtk2_block *(*row_new)(void *data);
+	// Update a row to display the specified item. Called during layout, from the thread drawing the window
+	void (*row_bind)(struct vtk2_block *row, size_t index, void *data);
+	// Free a row created by row_new, after it has been deinitialized. May be NULL if rows are freed some other way
+	void (*row_free)(struct vtk2_block *row, void *data);
+	void *data;
+
+	VTK2_BLOCK_SETTINGS;
+};
+#define VTK2_LIST_DEFAULTS \
+	.count = 0, \
+	.row_height = 20, \
+	.row_new = NULL, \
+	.row_bind = NULL, \
+	.row_free = NULL, \
+	.data = NULL
+
 //// Block constructors ////
-// THESE WILL ABORT IF ALLOCATION FAILS - USE ONCE AT PROGRAM START
+// THESE WILL ABORT IF ALLOCATION FAILS - USE ONCE AT PROGRAM START, OR USE THE ARENA CONSTRUCTORS BELOW
 struct vtk2_block *_vtk2_make_box(struct vtk2_box_settings settings);
 #define vtk2_make_box(...) _vtk2_make(box, VTK2_BOX_DEFAULTS, __VA_ARGS__)
 struct vtk2_block *_vtk2_make_static_text(struct vtk2_static_text_settings settings);
 #define vtk2_make_static_text(...) _vtk2_make(static_text, VTK2_STATIC_TEXT_DEFAULTS, __VA_ARGS__)
 struct vtk2_block *_vtk2_make_text(struct vtk2_text_settings settings);
 #define vtk2_make_text(...) _vtk2_make(text, VTK2_TEXT_DEFAULTS, __VA_ARGS__)
+struct vtk2_block *_vtk2_make_list(struct vtk2_list_settings settings);
+#define vtk2_make_list(...) _vtk2_make(list, VTK2_LIST_DEFAULTS, __VA_ARGS__)
+
+// Arena constructors - these allocate the block from an arena, and return VTK2_ERR_ALLOC on failure
+// Building a tree bottom-up places its blocks contiguously in depth-first order
+// Box child lists are copied into the arena, so they may be temporary
+enum vtk2_err _vtk2_new_box(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_box_settings settings);
+#define vtk2_new_box(arena, out, ...) _vtk2_new(box, arena, out, VTK2_BOX_DEFAULTS, __VA_ARGS__)
+enum vtk2_err _vtk2_new_static_text(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_static_text_settings settings);
+#define vtk2_new_static_text(arena, out, ...) _vtk2_new(static_text, arena, out, VTK2_STATIC_TEXT_DEFAULTS, __VA_ARGS__)
+enum vtk2_err _vtk2_new_text(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_text_settings settings);
+#define vtk2_new_text(arena, out, ...) _vtk2_new(text, arena, out, VTK2_TEXT_DEFAULTS, __VA_ARGS__)
+enum vtk2_err _vtk2_new_list(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_list_settings settings);
+#define vtk2_new_list(arena, out, ...) _vtk2_new(list, arena, out, VTK2_LIST_DEFAULTS, __VA_ARGS__)
+
+// Set the text of a block created with vtk2_make_text, copying it into memory owned by the block
+// If len is SIZE_MAX, the string is assumed to be null-terminated
+// Must be called from the main thread, with the window locked if it uses asynchronous layout
+enum vtk2_err vtk2_text_set(struct vtk2_block *block, const char *str, size_t len);
+
+// Post a change to a block from any thread, to be applied on the main thread at the start of the next frame.
+// Updates are applied in the order they were posted, and everything posted before a frame starts shares one layout.
+// The block must belong to a window, and must stay alive until the update is applied.
+// Returns VTK2_ERR_ALLOC if the update could not be queued. May be called concurrently.
+
+// Set the text of a block created with vtk2_make_text. The string is copied, so need not outlive the call.
+// If len is SIZE_MAX, the string is assumed to be null-terminated
+enum vtk2_err vtk2_post_text(struct vtk2_block *block, const char *str, size_t len);
+// Set the font color of a text block
+enum vtk2_err vtk2_post_color(struct vtk2_block *block, const float color[4]);
+// Set the requested size of a block
+enum vtk2_err vtk2_post_size(struct vtk2_block *block, const float size[2]);
+// Mark a block as needing layout and redraw
+enum vtk2_err vtk2_post_invalidate(struct vtk2_block *block);
+// Call fn on the main thread, for changes not covered by the other functions
+enum vtk2_err vtk2_post_fn(struct vtk2_block *block, void (*fn)(struct vtk2_block *block, void *data), void *data);
+
+// Change the children of a block created with vtk2_make_box
+// Only the affected child is initialized or deinitialized, and only that box and its parents are laid out again
+// The first change copies the child list into memory owned by the box, which is kept until vtk2_block_release
+// Like any other change to blocks, with asynchronous layout the window must be locked while doing this
+// Insert a child before the one at index; indices past the end append it
+enum vtk2_err vtk2_box_insert(struct vtk2_block *box, size_t index, struct vtk2_block *child);
+// Deinitialize and remove the child at index, returning it so it can be freed or inserted elsewhere
+// Updates posted to the child or its descendants that haven't been applied yet are discarded
+// Returns NULL if there is no such child, or if memory for the box's own child list could not be allocated
+struct vtk2_block *vtk2_box_remove(struct vtk2_block *box, size_t index);
+// Move the child at index from to index to, shifting the children in between
+enum vtk2_err vtk2_box_move(struct vtk2_block *box, size_t from, size_t to);
+size_t vtk2_box_count(struct vtk2_block *box);
+// Get the child at index, or NULL if there is no such child
+struct vtk2_block *vtk2_box_child(struct vtk2_block *box, size_t index);
+
+// Change the number of items in a block created with vtk2_make_list
+// Every visible row is bound again, so this can also be used to refresh the list after its items change
+// May be called concurrently.
+void vtk2_list_set_count(struct vtk2_block *block, size_t count);
+// Scroll a list so the specified offset, in pixels from the top of the first row, is at the top of the list
+// May be called concurrently.
+void vtk2_list_scroll_to(struct vtk2_block *block, double offset);
+
+//// Profiling ////
+// Only available if VTK2_PROFILE is defined, both when compiling vtk2 and any code using it
+#ifdef VTK2_PROFILE
+#define VTK2_PROFILE_FRAMES 128 // Number of frames of history kept
+
+enum vtk2_profile_kind {
+	VTK2_PROFILE_BOX,
+	VTK2_PROFILE_STATIC_TEXT,
+	VTK2_PROFILE_TEXT,
+	VTK2_PROFILE_LIST,
+	VTK2_PROFILE_OTHER,
+	VTK2_PROFILE_KINDS,
+};
+
+struct vtk2_frame_stats {
+	double start; // Time the frame started, in seconds on a monotonic clock; only meaningful relative to other frames
+	// Time spent in each phase, in seconds
+	double poll; // Checking dynamic blocks for changes
+	double layout; // Measuring and arranging blocks
+	double draw; // Issuing draw calls for blocks
+	double flush; // nvgEndFrame
+	double swap; // Compositing to the window and glfwSwapBuffers
+	// Counts
+	uint32_t measure_calls, arrange_calls; // Blocks measured and arranged (cached blocks aren't counted)
+	uint32_t text_fn_calls; // Calls to text_fn or text_gen_fn
+	uint32_t text_bounds_calls; // Calls to nvgTextBounds (text cache misses)
+	uint32_t draw_calls[VTK2_PROFILE_KINDS]; // Blocks drawn, by type
+	uint32_t replay_calls; // Blocks drawn by replaying their retained output
+};
+
+// Copy statistics for up to n of the most recently drawn frames into out, oldest first
+// Returns the number of frames copied
+size_t vtk2_window_stats(struct vtk2_win *win, struct vtk2_frame_stats *out, size_t n);
+
+// A block that graphs the time spent in each phase of recent frames
+// The graph is updated whenever the window draws a frame
+struct vtk2_profiler_settings {
+	float max_time; // Frame time, in seconds, shown by the full height of the graph
+
+	VTK2_BLOCK_SETTINGS;
+};
+#define VTK2_PROFILER_DEFAULTS \
+	.max_time = 1.0f / 30
+struct vtk2_block *_vtk2_make_profiler(struct vtk2_profiler_settings settings);
+#define vtk2_make_profiler(...) _vtk2_make(profiler, VTK2_PROFILER_DEFAULTS, __VA_ARGS__)
+enum vtk2_err _vtk2_new_profiler(struct vtk2_arena *arena, struct vtk2_block **out, struct vtk2_profiler_settings settings);
+#define vtk2_new_profiler(arena, out, ...) _vtk2_new(profiler, arena, out, VTK2_PROFILER_DEFAULTS, __VA_ARGS__)
+#endif
 
 //// Type definitions (advanced users only) ////
+#define VTK2_MAX_DAMAGE 16
+#define VTK2_TEXT_CACHE_MAX 4096 // Maximum number of slots in the text measurement cache
+struct NVGLUframebuffer;
+
+// A function to be called on a block at the start of every frame
+struct vtk2_poll {
+	struct vtk2_block *block;
+	void (*fn)(struct vtk2_block *);
+};
+
+enum vtk2_update_kind {
+	VTK2_UPDATE_TEXT,
+	VTK2_UPDATE_COLOR,
+	VTK2_UPDATE_SIZE,
+	VTK2_UPDATE_INVALIDATE,
+	VTK2_UPDATE_FN,
+};
+
+// A change to a block, posted from another thread to be applied at the start of the next frame
+struct vtk2_update {
+	_Atomic(struct vtk2_update *) next;
+	struct vtk2_block *block; // NULL if cancelled
+	enum vtk2_update_kind kind;
+	union {
+		struct {
+			char *text;
+			size_t len;
+		};
+		float color[4];
+		float size[2];
+		struct {
+			void (*fn)(struct vtk2_block *block, void *data);
+			void *data;
+		};
+	};
+};
+
+enum vtk2_input_kind {
+	VTK2_INPUT_BUTTON,
+	VTK2_INPUT_ENTER,
+	VTK2_INPUT_KEY,
+	VTK2_INPUT_MOUSE,
+	VTK2_INPUT_SCROLL,
+	VTK2_INPUT_TEXT,
+};
+
+// An input event, queued to be delivered at the start of the next frame
+struct vtk2_input {
+	enum vtk2_input_kind kind;
+	union {
+		struct {
+			int button, action, mods;
+		} button;
+		_Bool entered;
+		struct {
+			int key, scancode, action, mods;
+		} key;
+		float pos[2]; // Mouse
+		float delta[2]; // Scroll
+		unsigned rune;
+	};
+};
+
+// Cached measurements of a string, keyed by hash, length, font and size
+struct vtk2_text_metrics {
+	uint64_t hash; // 0 if unused
+	char *str; // Owned copy of the measured text, compared on every hit
+	size_t len;
+	int font;
+	float size;
+	float w, h;
+};
+
+struct vtk2_app {
+	// Try not to mess with these directly
+	_Atomic(struct vtk2_win *) queued; // Windows that have been updated since the last iteration
+	struct vtk2_win *pending; // Windows waiting for a frame
+	size_t nwindows;
+};
+
 struct vtk2_win {
 	// Try not to mess with these directly
 	atomic_flag clean; // Clear if the window must be redrawn
+	atomic_bool damage_all; // Set if the entire window must be redrawn
 	NVGcontext *vg;
+	void *egl_display, *egl_context; // Only used by headless windows
+	struct NVGLUframebuffer *fb; // Persistent back buffer, so undamaged regions can be kept between frames
 	GLFWwindow *win;
 	struct vtk2_block *focused;
+	struct vtk2_block *hover; // Deepest block known to be under the cursor, or NULL if that must be found again
+	float hover_bounds[4]; // x0, y0, x1, y1 of the region inside every block from the root to hover
+	size_t hover_gen; // Incremented whenever hover is forgotten
 
 	// Don't write to these
 	float cx, cy; // Cursor pos
 	uint32_t fb_w, fb_h; // Framebuffer size
 	float win_w, win_h; // Window size
 	struct vtk2_block *root;
+	float damage[VTK2_MAX_DAMAGE][4]; // Regions to redraw next frame
+	int ndamage;
+	float clip[4]; // Region currently being drawn; blocks outside it need not be drawn
+	struct vtk2_text_metrics *text_cache; // Open-addressed hash table
+	size_t text_cache_cap, text_cache_len;
+	struct vtk2_poll *polls;
+	size_t npolls, polls_cap;
+	struct vtk2_input *input; // Events received since the last frame
+	size_t ninput, input_cap;
+	struct vtk2_block *commits; // Blocks laid out since the last commit
+
+	// Asynchronous layout
+	_Bool async;
+	thrd_t layout_thread;
+	mtx_t layout_lock; // Held while blocks are being laid out
+	mtx_t layout_wait; // Protects layout_quit and layout_job
+	cnd_t layout_cond; // Signalled when a layout is requested
+	atomic_int layout_state;
+	_Bool layout_quit;
+	float layout_job[4]; // Rect to lay the root out in
+	mtx_t vg_lock; // Held while using vg, so text can be measured during drawing
+	mtx_t text_lock; // Protects text_cache
+	struct vtk2_pool *pool; // Threads for parallel layout, if enabled
+	struct vtk2_b_box *layers; // Boxes drawn through layers
+
+	// Frame pacing
+	atomic_bool wake_posted; // Set if the main loop has been woken for a frame it hasn't started yet
+	_Atomic double frame_deadline; // Time the next frame may start
+	double frame_interval; // Minimum time between frames, in seconds
+	double frame_next; // Time the main loop will next start a frame
+	void (*frame_fn)(struct vtk2_win *win, double deadline, void *data);
+	void *frame_data;
+
+	// Multi-window main loop
+	struct vtk2_app *app; // App the window belongs to, if any
+	atomic_bool app_queued; // Set if the window is in the app's queued or pending list
+	struct vtk2_win *app_next;
+
+	// Updates posted from other threads
+	_Atomic(struct vtk2_update *) updates_head; // Most recently posted
+	struct vtk2_update *updates_tail; // Next to be applied
+	struct vtk2_update updates_stub; // Keeps the queue non-empty
+
+#ifdef VTK2_PROFILE
+	struct vtk2_frame_stats stats[VTK2_PROFILE_FRAMES]; // Ring buffer of recent frames
+	size_t stats_frame; // Number of frames drawn; the current frame is stored at stats_frame % VTK2_PROFILE_FRAMES
+	double stats_mark; // End of the last timed phase
+	struct vtk2_frame_stats layout_stats; // Counts from layouts that haven't been committed yet
+#endif
 };
 
-struct vtk2_block {
-	// Public-ish fields - prefer constructors over directly accessing these
-	float grow;
-	float margins[4];
-	float size[2];
-
-	// Only touch this stuff if you're defining custom block types
+// Callbacks shared by every block of a type
+// Custom block types should define one of these statically and point each block's type at it:
+//   static const struct vtk2_block_type my_type = {.draw = my_draw, .ev_button = my_button};
+//   *block = (struct my_block){.base = {.type = &my_type}};
+// Blocks that used to set these callbacks on themselves can move them into such a struct unchanged
+struct vtk2_block_type {
 	enum vtk2_err (*init)(struct vtk2_block *);
+	// Blocks may be deinitialized and initialized again, eg. when moved between boxes, so deinit should keep
+	// any state set through the API, such as text; release frees it once the block is done with for good
 	void (*deinit)(struct vtk2_block *);
+	void (*release)(struct vtk2_block *);
+	// Set pref to the preferred size of the block, measuring any children first
+	// Blocks with children should also add each child's weight to their own
+	// If this is NULL but layout is set, layout is called against an unbounded rect to find the preferred size
+	void (*measure)(struct vtk2_block *);
+	// Set rect to the final size of the block, arranging any children within it
+	// On entry, rect contains the space available to the block
 	void (*layout)(struct vtk2_block *, enum vtk2_shrink shrink);
+	// Called on the drawing thread when the results of laying out the block become visible
+	// Any state computed during layout that draw or event callbacks use should be copied here
+	void (*commit)(struct vtk2_block *);
 	void (*draw)(struct vtk2_block *);
+	// Set to keep the tessellated output of draw and replay it until the block is damaged or moves
+	// Only suitable if draw depends on nothing but the block's own state, and doesn't draw other blocks
+	_Bool retain;
+	// Set to get an ev_mouse call for every cursor movement over the block
+	// Otherwise, movements between frames are merged into one
+	_Bool raw_motion;
 	_Bool (*ev_button)(struct vtk2_block *, int button, int action, int mods);
 	_Bool (*ev_enter)(struct vtk2_block *, _Bool entered);
 	_Bool (*ev_key)(struct vtk2_block *, int key, int scancode, int action, int mods);
 	_Bool (*ev_mouse)(struct vtk2_block *, float new_x, float new_y, float old_x, float old_y);
+	_Bool (*ev_scroll)(struct vtk2_block *, float dx, float dy);
 	_Bool (*ev_text)(struct vtk2_block *, unsigned rune);
+};
+
+struct vtk2_block {
+	// Public-ish fields - prefer constructors over directly accessing these
+	float grow;
+	float margins[4];
+	float size[2];
+
+	// Only touch this if you're defining custom block types
+	// May be NULL, in which case the block fills whatever space it is given and draws nothing
+	const struct vtk2_block_type *type;
 
 	// Read-only
-	float rect[4];
+	float pref[2]; // Preferred size, INFINITY if the block fills whatever space it is given
+	float rect[4]; // Result of the most recent layout
+	float draw_rect[4]; // Rect the block is currently displayed at; draw and event callbacks should use this
 	struct vtk2_win *win;
+	// Custom blocks with children must set this on each child before initializing it
+	struct vtk2_block *parent;
+
+	// Layout cache
+	atomic_bool dirty; // Set if the block must be measured again
+	atomic_bool damaged; // Set if the block must be redrawn
+	_Bool measured; // Set if the block has been measured since it was last arranged
+	size_t weight; // Number of blocks in the subtree, used to decide what to lay out in parallel
+	_Bool serial; // Set if the subtree must be arranged by the thread that started the layout, eg. because it has a list
+	float layout_rect[4]; // Rect passed to the last arrange
+	enum vtk2_shrink layout_shrink; // Shrink passed to the last arrange
+	_Bool queued; // Set if the block is waiting to be committed
+	_Bool redraw; // Set if the block must be redrawn when it is committed
+	struct vtk2_block *commit_next;
+	struct vtk2_draw_list *retained; // Output of the last draw, if retain is set
 };
 
 //// Internal block type definitions, don't touch except for language bindings ////
 struct vtk2_b_box {
 	struct vtk2_block base;
 	enum vtk2_direction direction;
-	struct vtk2_block **children;
+	struct vtk2_block **children; // Borrowed from the settings until the box is changed, then owned by the box
+
+	size_t nchildren;
+	size_t children_cap; // 0 if children is borrowed
+	_Bool indexed; // Children can be binary searched along the main axis
+	_Bool layout_indexed; // Value of indexed as of the last layout
+
+	// Packed copies of each child's layout inputs, filled in by measure
+	float *child_basis; // Size along the main axis, including margins
+	float *child_cross; // Size along the cross axis, including margins
+	float *child_grow;
+	float *child_slot; // Space given to each child along the main axis by the last layout
+	float basis_total, grow_total;
+
+	_Bool layer;
+	_Bool layer_valid; // Set if layer_fb holds the current contents of the box
+	struct NVGLUframebuffer *layer_fb;
+	struct vtk2_b_box *layer_next; // Next box with a layer in the same window
 };
 
 struct vtk2_b_static_text {
@@ -233,17 +689,62 @@ struct vtk2_b_static_text {
 	VTK2_FONT_SETTINGS;
 
 	int font_handle;
+	float ascend;
 };
 
 struct vtk2_b_text {
 	struct vtk2_block base;
 	const char *(*text_fn)(size_t *len, void *data);
+	const char *(*text_gen_fn)(size_t *len, uint64_t *gen, void *data);
 	void *data;
 	VTK2_FONT_SETTINGS;
 
 	int font_handle;
+	float ascend;
+	char *buf; // Copy of the current text
+	size_t len, cap;
+	uint64_t gen;
+};
+
+struct vtk2_list_slot {
+	struct vtk2_block *row;
+	size_t item; // Item the row is bound to, or SIZE_MAX
+};
+
+struct vtk2_b_list {
+	struct vtk2_block base;
+	atomic_size_t count;
+	float row_height;
+	struct vtk2_block *(*row_new)(void *data);
+	void (*row_bind)(struct vtk2_block *row, size_t index, void *data);
+	void (*row_free)(struct vtk2_block *row, void *data);
+	void *data;
+
+	_Atomic double scroll; // Requested scroll position; double so precision holds up in very long lists
+	atomic_bool rebind; // Set if every row must be bound again
+	_Bool dragging;
+
+	// Layout state; item i is displayed by slots[i % nslots]
+	struct vtk2_list_slot *slots;
+	size_t nslots;
+	size_t first, last; // Range of visible items
+	double offset;
+	_Bool pending; // Set if some rows couldn't be bound because they were still being displayed
+
+	// Copy of the layout state as of the last commit, for drawing and events
+	struct vtk2_list_slot *shown;
+	size_t nshown;
+	size_t shown_first, shown_last;
+	double shown_offset;
 };
 
+#ifdef VTK2_PROFILE
+struct vtk2_b_profiler {
+	struct vtk2_block base;
+	float max_time;
+};
+#endif
+
 //// Helpers ////
 #define fieldParentPtr(T, field_name, value) ((T *)((char *)(value) - offsetof(T, field_name)))
 